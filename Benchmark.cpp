@@ -0,0 +1,348 @@
+/*********************************************************
+*  ħҵܻ׼
+*
+*  ÷
+*  g++ -std=c++17 -O2 -pthread -DWARCRAFT_TARGET=3 Benchmark.cpp -o bench3
+*  ./bench3 [ѡ] [-- Warcraft3ѡ]
+*  WARCRAFT_TARGETȡ1, 2, 3ֱWarcraft1.cpp, Warcraft2.cpp, Warcraft3.cpp
+*
+*  ׼ѶӦԴļֱӰmainΪwarcraft_main
+*  ѡmain()룬дʱļضΪ׼룬
+*  ׼ضʱļظɴȡһ
+*  ȫoperator new滻ͳƷ
+*  һJSONд׼
+*
+*  ѡ(Χдlo:hi򵥸)
+*  --profile random|adversarial  ԤѡԸ
+*  --cases N          
+*  --cities R         (Warcraft3)
+*  --end-time R       ʱ䣬λ(Warcraft3)
+*  --base-hp R        ˾ʼԪ
+*  --warrior-hp R     ʿֵ
+*  --force R          ʿ(Warcraft3)Ϊ5
+*  --loyalty R        lionÿǰһٵҳ϶(Warcraft3)
+*  --seed N           
+*  --repeat N         ظд
+*  --binary           ɶƸʽ(input_reader)
+*  --emit-input       ֻɵ룬
+*********************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <array>
+#include <random>
+#include <chrono>
+#include <atomic>
+#include <new>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+#ifdef _WIN32
+#include <io.h>
+#define dup _dup
+#define dup2 _dup2
+#define fileno _fileno
+#define close _close
+#define lseek _lseek
+#else
+#include <unistd.h>
+#endif
+
+#ifndef WARCRAFT_TARGET
+#define WARCRAFT_TARGET 3
+#endif
+
+#define main warcraft_main
+#if WARCRAFT_TARGET == 1
+#include "Warcraft1.cpp"
+#elif WARCRAFT_TARGET == 2
+#include "Warcraft2.cpp"
+#else
+#include "Warcraft3.cpp"
+#endif
+#undef main
+
+namespace warcraft_bench
+{
+	std::atomic<std::size_t> allocation_count{ 0 };
+
+	// [low, high]
+	struct int_range {
+		int low, high;
+	};
+
+	struct bench_options {
+		std::string profile = "random";
+		int cases = 100;
+		int_range cities{ 1, 20 }, end_time{ 1000, 6000 }, base_HP{ 100, 10000 },
+			warrior_HP{ 1, 200 }, force{ 5, 200 }, loyalty{ 1, 100 };
+		unsigned seed = 1;
+		int repeat = 5;
+		bool binary = false, emit_input = false;
+		// Warcraft3Уargv[0]Ϊnullptrβ
+		std::vector<char*> target_args;
+	};
+
+	// Կ룺жࡢʱ䳤ʿѪ񹥻ͣսغͬʱʿܴ
+	void set_adversarial(bench_options& options)
+	{
+		options.cities = { 500, 1000 };
+		options.end_time = { 60000, 60000 };
+		options.base_HP = { 100000, 100000 };
+		options.warrior_HP = { 1000, 5000 };
+		options.force = { 5, 10 };
+		options.loyalty = { 1, 1 };
+	}
+
+	bool parse_range(const char* text, int_range& range)
+	{
+		char* end;
+		range.low = static_cast<int>(std::strtol(text, &end, 10));
+		if (end == text)
+			return false;
+		range.high = range.low;
+		if (*end == ':') {
+			const char* high = end + 1;
+			range.high = static_cast<int>(std::strtol(high, &end, 10));
+			if (end == high)
+				return false;
+		}
+		return *end == '\0' and range.low <= range.high;
+	}
+
+	class input_generator {
+	private:
+		std::mt19937 _engine;
+		const bench_options& _options;
+
+		int draw(int_range range) { return std::uniform_int_distribution<int>(range.low, range.high)(_engine); }
+
+		// ÿе
+#if WARCRAFT_TARGET == 3
+		constexpr static std::array<int, 3> line_sizes{ 4, warcraft::warrior_type_count, warcraft::warrior_type_count };
+#else
+		constexpr static std::array<int, 2> line_sizes{ 1, 5 };
+#endif
+
+		// main()ȡ˳
+		std::vector<int> generate_values()
+		{
+			std::vector<int> values{ _options.cases };
+			for (int i = 0; i < _options.cases; ++i) {
+#if WARCRAFT_TARGET == 3
+				values.insert(values.end(), { draw(_options.base_HP), draw(_options.cities), draw(_options.loyalty), draw(_options.end_time) });
+				for (int j = 0; j < warcraft::warrior_type_count; ++j)
+					values.push_back(draw(_options.warrior_HP));
+				// 5ʱsword˺Ϊ0˫޷˺ս
+				int_range force{ std::max(_options.force.low, 5), std::max(_options.force.high, 5) };
+				for (int j = 0; j < warcraft::warrior_type_count; ++j)
+					values.push_back(draw(force));
+#else
+				values.push_back(draw(_options.base_HP));
+				for (int j = 0; j < 5; ++j)
+					values.push_back(draw(_options.warrior_HP));
+#endif
+			}
+			return values;
+		}
+	public:
+		input_generator(const bench_options& options) : _engine(options.seed), _options(options) {}
+
+		// WARCRAFT_TARGETӦmain()
+		std::string generate()
+		{
+			auto values = generate_values();
+			if (_options.binary) {
+				std::string input(warcraft::input_reader::binary_magic);
+				for (int value : values) {
+					auto bits = static_cast<std::uint32_t>(value);
+					for (int shift = 0; shift < 32; shift += 8)
+						input.push_back(static_cast<char>(bits >> shift & 0xff));
+				}
+				return input;
+			}
+			std::ostringstream input;
+			input << values[0] << '\n';
+			std::size_t index = 1;
+			while (index < values.size())
+				for (int size : line_sizes)
+					for (int j = 0; j < size; ++j)
+						input << values[index++] << (j + 1 < size ? ' ' : '\n');
+			return input.str();
+		}
+	};
+
+	// ͳģʱ
+	// ÿֵʱȡһ¼ʱ̼һӣֻȷСʱļ¼Сʱ
+	long long simulated_minutes(std::FILE* output)
+	{
+		std::rewind(output);
+		long long total = 0, last = -1;
+		char line[512];
+		while (std::fgets(line, sizeof(line), output)) {
+			if (std::strncmp(line, "Case", 4) == 0) {
+				total += last + 1;
+				last = -1;
+				continue;
+			}
+			char* end;
+			long long hour = std::strtoll(line, &end, 10);
+			if (end == line)
+				continue;
+			long long time = (*end == ':' ? hour * 60 + std::strtoll(end + 1, nullptr, 10) : hour * 60 + 59);
+			last = std::max(last, time);
+		}
+		return total + last + 1;
+	}
+
+	struct bench_result {
+		double seconds = 0;
+		std::size_t allocations = 0;
+		long long minutes = 0;
+		long output_bytes = 0;
+	};
+
+	bench_result run(const bench_options& options, const std::string& input)
+	{
+		using clock = std::chrono::steady_clock;
+		bench_result result;
+		result.seconds = 1e100;
+
+		std::fflush(stdout);
+		std::cout.flush();
+		int saved_stdin = dup(0), saved_stdout = dup(1);
+		std::FILE* input_file = std::tmpfile(), * output = std::tmpfile();
+		if (saved_stdin < 0 or saved_stdout < 0 or !input_file or !output) {
+			std::perror("benchmark");
+			std::exit(1);
+		}
+		std::fwrite(input.data(), 1, input.size(), input_file);
+		std::fflush(input_file);
+		dup2(fileno(input_file), 0);
+		dup2(fileno(output), 1);
+
+		for (int i = 0; i < options.repeat; ++i) {
+			lseek(0, 0, SEEK_SET);
+			std::rewind(output);
+#ifndef _WIN32
+			if (ftruncate(1, 0) != 0)
+				std::perror("benchmark");
+#endif
+
+			allocation_count = 0;
+			auto start = clock::now();
+#if WARCRAFT_TARGET == 3
+			warcraft_main(static_cast<int>(options.target_args.size()) - 1, const_cast<char**>(options.target_args.data()));
+#else
+			warcraft_main();
+#endif
+			std::cout.flush();
+			std::fflush(stdout);
+			double seconds = std::chrono::duration<double>(clock::now() - start).count();
+			result.seconds = std::min(result.seconds, seconds);
+			result.allocations = allocation_count;
+		}
+
+		dup2(saved_stdin, 0);
+		dup2(saved_stdout, 1);
+		close(saved_stdin);
+		close(saved_stdout);
+		std::fclose(input_file);
+		std::fseek(output, 0, SEEK_END);
+		result.output_bytes = std::ftell(output);
+		result.minutes = simulated_minutes(output);
+		std::fclose(output);
+		return result;
+	}
+}
+
+void* operator new(std::size_t size)
+{
+	warcraft_bench::allocation_count.fetch_add(1, std::memory_order_relaxed);
+	if (void* pointer = std::malloc(size ? size : 1))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { std::free(pointer); }
+
+int main(int argc, char* argv[])
+{
+	using namespace warcraft_bench;
+	bench_options options;
+	options.target_args.push_back(argv[0]);
+
+	// ȴԤ裬ʹѡܸԤֵ
+	for (int i = 1; i + 1 < argc and std::strcmp(argv[i], "--") != 0; ++i)
+		if (std::strcmp(argv[i], "--profile") == 0 and std::strcmp(argv[i + 1], "adversarial") == 0)
+			set_adversarial(options);
+
+	for (int i = 1; i < argc; ++i) {
+		auto range_option = [&](const char* option, int_range& range) {
+			return std::strcmp(argv[i], option) == 0 and i + 1 < argc and parse_range(argv[++i], range);
+		};
+		if (std::strcmp(argv[i], "--") == 0) {
+			options.target_args.insert(options.target_args.end(), argv + i + 1, argv + argc);
+			break;
+		}
+		else if (std::strcmp(argv[i], "--profile") == 0 and i + 1 < argc
+			and (std::strcmp(argv[i + 1], "random") == 0 or std::strcmp(argv[i + 1], "adversarial") == 0)) {
+			options.profile = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--cases") == 0 and i + 1 < argc) {
+			options.cases = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "--seed") == 0 and i + 1 < argc) {
+			options.seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--repeat") == 0 and i + 1 < argc) {
+			options.repeat = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "--binary") == 0) {
+			options.binary = true;
+		}
+		else if (std::strcmp(argv[i], "--emit-input") == 0) {
+			options.emit_input = true;
+		}
+		else if (range_option("--cities", options.cities) or range_option("--end-time", options.end_time)
+			or range_option("--base-hp", options.base_HP) or range_option("--warrior-hp", options.warrior_HP)
+			or range_option("--force", options.force) or range_option("--loyalty", options.loyalty)) {
+		}
+		else {
+			std::cerr << "unknown or invalid option: " << argv[i] << std::endl;
+			return 1;
+		}
+	}
+	options.target_args.push_back(nullptr);
+
+	std::string input = input_generator(options).generate();
+	if (options.emit_input) {
+		std::cout.write(input.data(), input.size());
+		return 0;
+	}
+
+	bench_result result = run(options, input);
+	double ns = result.seconds * 1e9;
+	// Warcraft2޸std::coutĸʽ
+	std::cout.unsetf(std::ios::floatfield);
+	std::cout.precision(6);
+	std::cout << "{\"target\":\"Warcraft" << WARCRAFT_TARGET << "\""
+		<< ",\"profile\":\"" << options.profile << "\""
+		<< ",\"binary\":" << (options.binary ? "true" : "false")
+		<< ",\"seed\":" << options.seed
+		<< ",\"cases\":" << options.cases
+		<< ",\"repeat\":" << options.repeat
+		<< ",\"seconds\":" << result.seconds
+		<< ",\"cases_per_second\":" << options.cases / result.seconds
+		<< ",\"simulated_minutes\":" << result.minutes
+		<< ",\"ns_per_minute\":" << (result.minutes > 0 ? ns / result.minutes : 0)
+		<< ",\"allocations_per_case\":" << static_cast<double>(result.allocations) / options.cases
+		<< ",\"output_bytes\":" << result.output_bytes
+		<< "}" << std::endl;
+	return 0;
+}
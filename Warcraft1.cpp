@@ -2,8 +2,20 @@
 #include <vector>
 #include <array>
 #include <tuple>
-#include <any>
 #include <iomanip>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cctype>
+#include <cerrno>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 namespace warcraft {
     enum class camp_label : int8_t {
@@ -15,7 +27,7 @@ namespace warcraft {
         stop_generate_warrior
     };
 
-    const std::string camp_name(camp_label camp) noexcept
+    constexpr std::string_view camp_name(camp_label camp) noexcept
     {
         switch (camp) {
         case camp_label::red:
@@ -35,117 +47,173 @@ namespace warcraft {
         return time % 60;
     }
 
-    class game_controller;
-
-    class game_object {
-    public:
-        virtual ~game_object() = default;
-        virtual void on_update_time(int new_time) {}
+    // ʱʽhhhֱдʱַ
+    struct hour_stamp {
+        int time;
     };
 
-    class warrior;
+    std::ostream& operator<<(std::ostream& os, hour_stamp stamp)
+    {
+        char buffer[16], * end = buffer;
+        int h = hour(stamp.time);
+        if (h < 1000) {
+            *end++ = '0' + h / 100;
+            *end++ = '0' + h / 10 % 10;
+            *end++ = '0' + h % 10;
+        }
+        else {
+            end = std::to_chars(buffer, buffer + sizeof(buffer), h).ptr;
+        }
+        return os.write(buffer, end - buffer);
+    }
 
-    class city : public game_object {
+    // ȡ
+    // ͨļʱmmapӳ䣬򰴴ڴ棬from_chars
+    // binary_magicͷǶƸʽ֮ÿ4ֽС룬˳ıʽͬ
+    class input_reader {
+    private:
+        const char* _current = nullptr, * _end = nullptr;
+        // mmapʱȫ
+        std::vector<char> _buffer;
+        void* _mapping = nullptr;
+        std::size_t _mapping_size = 0;
+        bool _binary = false, _failed = false;
     public:
-        virtual ~city() = default;
+        constexpr static std::string_view binary_magic = "WCRB";
+        constexpr static std::size_t block_size = 1 << 20;
+
+        explicit input_reader(int fd);
+        input_reader(const input_reader&) = delete;
+        input_reader& operator=(const input_reader&) = delete;
+        ~input_reader();
+
+        // ȡһʧʱvalueΪ0֮Ķȡʧ
+        input_reader& operator>>(int& value);
+        explicit operator bool() const noexcept { return !_failed; }
     };
 
+    input_reader::input_reader(int fd)
+    {
+#ifndef _WIN32
+        struct stat info;
+        if (::fstat(fd, &info) == 0 and S_ISREG(info.st_mode) and info.st_size > 0) {
+            void* mapping = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                _mapping = mapping;
+                _mapping_size = info.st_size;
+                _current = static_cast<const char*>(mapping);
+                _end = _current + _mapping_size;
+            }
+        }
+#endif
+        if (!_mapping) {
+            std::size_t size = 0;
+            while (true) {
+                _buffer.resize(size + block_size);
+#ifdef _WIN32
+                auto count = ::_read(fd, _buffer.data() + size, static_cast<unsigned>(block_size));
+#else
+                auto count = ::read(fd, _buffer.data() + size, block_size);
+#endif
+                if (count < 0 and errno == EINTR)
+                    continue;
+                if (count <= 0)
+                    break;
+                size += count;
+            }
+            _buffer.resize(size);
+            _current = _buffer.data();
+            _end = _current + size;
+        }
+        if (static_cast<std::size_t>(_end - _current) >= binary_magic.size()
+            and std::string_view(_current, binary_magic.size()) == binary_magic) {
+            _binary = true;
+            _current += binary_magic.size();
+        }
+    }
+
+    input_reader::~input_reader()
+    {
+#ifndef _WIN32
+        if (_mapping)
+            ::munmap(_mapping, _mapping_size);
+#endif
+    }
+
+    input_reader& input_reader::operator>>(int& value)
+    {
+        value = 0;
+        if (_failed)
+            return *this;
+        if (_binary) {
+            if (_end - _current < 4) {
+                _failed = true;
+                return *this;
+            }
+            auto bytes = reinterpret_cast<const unsigned char*>(_current);
+            value = static_cast<std::int32_t>(bytes[0] | bytes[1] << 8 | bytes[2] << 16 | static_cast<std::uint32_t>(bytes[3]) << 24);
+            _current += 4;
+            return *this;
+        }
+        while (_current != _end and std::isspace(static_cast<unsigned char>(*_current)))
+            ++_current;
+        auto [ptr, error] = std::from_chars(_current, _end, value);
+        if (error != std::errc()) {
+            _failed = true;
+            value = 0;
+            return *this;
+        }
+        _current = ptr;
+        return *this;
+    }
+
+    class game_controller;
+
     constexpr int warrior_type_count = 5;
 
-    class headquarter : public city {
+    class headquarter {
     protected:
         game_controller* _controller;
 
         camp_label _camp;
         int _health_point;
-        std::vector<std::unique_ptr<warrior>> _warriors; // RAII
 
         int _last_generate_warrior = -1;
+        // ʿʿֻ¼
+        int _generated_count = 0;
         std::array<int, warrior_type_count> _warrior_record{ 0 };
         bool _stopped = false;
     public:
         headquarter(camp_label camp, int health_point, game_controller* controller) noexcept
-            : _camp(camp), _health_point(health_point), _controller(controller) {}
-        virtual ~headquarter() = default;
+            : _controller(controller), _camp(camp), _health_point(health_point) {}
 
-        virtual void on_update_time(int new_time) override;
+        void on_update_time(int new_time);
+        // ңֱ˳ϴ֮deltaʿ֤߱Ԫ㹻
+        void generate_next_warrior(int time, int delta = 1);
     protected:
         void generate_warrior(int time);
     };
 
-    class warrior {
-    protected:
-        camp_label _camp;
-        int _health_point;
-        int _id;
-    public:
-        warrior(camp_label camp, int health_point, int id) noexcept
-            : _camp(camp), _health_point(health_point), _id(id) {}
-        virtual ~warrior() = default;
-    };
-
-    class iceman : public warrior {
-    public:
-        using warrior::warrior;
-        virtual ~iceman() = default;
-    };
-
-    class lion : public warrior {
-    public:
-        using warrior::warrior;
-        virtual ~lion() = default;
-    };
-
-    class wolf : public warrior {
-    public:
-        using warrior::warrior;
-        virtual ~wolf() = default;
-    };
-
-    class ninja : public warrior {
-    public:
-        using warrior::warrior;
-        virtual ~ninja() = default;
-    };
-
-    class dragon : public warrior {
-    public:
-        using warrior::warrior;
-        virtual ~dragon() = default;
-    };
-
     constexpr char warrior_name[warrior_type_count][7] = { "dragon", "ninja", "iceman", "lion", "wolf" };
-    std::unique_ptr<warrior> get_warrior(int index, camp_label camp, int health_point, int id)
-    {
-        switch (index) {
-        case 0:
-            return std::make_unique<dragon>(camp, health_point, id);
-        case 1:
-            return std::make_unique<ninja>(camp, health_point, id);
-        case 2:
-            return std::make_unique<iceman>(camp, health_point, id);
-        case 3:
-            return std::make_unique<lion>(camp, health_point, id);
-        case 4:
-            return std::make_unique<wolf>(camp, health_point, id);
-        default:
-            return nullptr;
-        }
-    }
+    constexpr int red_order[warrior_type_count] = { 2, 3, 4, 1, 0 },
+        blue_order[warrior_type_count] = { 3, 0, 1, 2, 4 };
 
     class game_controller {
     private:
         const std::array<int, 5> _warrior_HP;
 
-        std::vector<std::unique_ptr<city>> _citys;
+        // ˫˾±ΪӪ
+        std::array<headquarter, 2> _headquarters;
 
         int _left_generating = 2;
+        // ʼʱ˫
+        int _full_cycles = 0;
     public:
-        game_controller(int base_HP, int city_count, const std::array<int, 5>& warrior_HP);
+        game_controller(int base_HP, const std::array<int, 5>& warrior_HP);
 
         int warrior_HP(int n) const { return _warrior_HP[n]; }
 
-        void send_message(game_message msg, std::any param = {});
+        void send_message(game_message msg) noexcept;
         void run();
     };
 
@@ -156,51 +224,56 @@ namespace warcraft {
             generate_warrior(new_time);
             break;
         }
-        city::on_update_time(new_time);
     }
 
     void headquarter::generate_warrior(int time)
     {
         if (_stopped) return;
-        static constexpr int red_order[] = { 2, 3, 4, 1, 0 },
-            blue_order[] = { 3, 0, 1, 2, 4 };
         const auto& order = (_camp == camp_label::red) ? red_order : blue_order;
         int delta_warrior_type = 1;
         for (; delta_warrior_type <= 5; ++delta_warrior_type)
             if (_health_point >= _controller->warrior_HP(order[(_last_generate_warrior + delta_warrior_type) % 5]))
                 break;
         if (delta_warrior_type == 6) {
-            std::cout << std::setw(3) << std::setfill('0') << hour(time) << ' '
-                << camp_name(_camp) << " headquarter stops making warriors" << std::endl;
+            std::cout << hour_stamp{ time } << ' '
+                << camp_name(_camp) << " headquarter stops making warriors" << '\n';
             _controller->send_message(game_message::stop_generate_warrior);
             _stopped = true;
             return;
         }
-        _last_generate_warrior = (_last_generate_warrior + delta_warrior_type) % 5;
+        generate_next_warrior(time, delta_warrior_type);
+    }
+
+    void headquarter::generate_next_warrior(int time, int delta)
+    {
+        const auto& order = (_camp == camp_label::red) ? red_order : blue_order;
+        _last_generate_warrior = (_last_generate_warrior + delta) % 5;
         int index = order[_last_generate_warrior];
         const auto& name = warrior_name[index];
-        int id = _warriors.size() + 1, hp = _controller->warrior_HP(index);
+        int id = ++_generated_count, hp = _controller->warrior_HP(index);
         ++_warrior_record[index];
         _health_point -= hp;
-        _warriors.emplace_back(get_warrior(index, _camp, hp, id));
-        std::cout << std::setw(3) << std::setfill('0') << hour(time) << ' '
+        std::cout << hour_stamp{ time } << ' '
             << camp_name(_camp) << ' ' << name << ' '
             << id << " born with strength " << hp << ','
             << _warrior_record[index] << ' ' << name << " in "
-            << camp_name(_camp) << " headquarter" << std::endl;
+            << camp_name(_camp) << " headquarter" << '\n';
     }
     
-    game_controller::game_controller(int base_HP, int city_count, const std::array<int, 5>& warrior_HP)
+    game_controller::game_controller(int base_HP, const std::array<int, 5>& warrior_HP)
         : _warrior_HP(warrior_HP),
-        _citys(city_count + 2)
+        _headquarters{ { headquarter(camp_label::red, base_HP, this), headquarter(camp_label::blue, base_HP, this) } }
     {
-        _citys.front() = std::make_unique<headquarter>(camp_label::red, base_HP, this);
-        _citys.back() = std::make_unique<headquarter>(camp_label::blue, base_HP, this);
-        for (int i = 1; i <= city_count; ++i)
-            _citys[i] = std::make_unique<city>();
+        // ԪʿܺʱСʱһθһκһ
+        // ˫ĳʼԪͬҲͬ
+        long long cycle_HP = 0;
+        for (int hp : warrior_HP)
+            cycle_HP += hp;
+        if (cycle_HP > 0 and base_HP > 0)
+            _full_cycles = base_HP / cycle_HP;
     }
     
-    void game_controller::send_message(game_message msg, std::any param)
+    void game_controller::send_message(game_message msg) noexcept
     {
         switch (msg) {
         case game_message::stop_generate_warrior:
@@ -213,30 +286,39 @@ namespace warcraft {
     
     void game_controller::run()
     {
+        auto& [red, blue] = _headquarters;
         int time = 0;
-        for (; _left_generating > 0; time += 60) {
-            for (auto& city : _citys) {
-                city->on_update_time(time);
+        // ׶ΣÿСʱ˫ֱ˳еһ֣Ҫ
+        for (int cycle = 0; cycle < _full_cycles; ++cycle)
+            for (int k = 0; k < warrior_type_count; ++k, time += 60) {
+                red.generate_next_warrior(time);
+                blue.generate_next_warrior(time);
             }
+        for (; _left_generating > 0; time += 60) {
+            for (auto& headquarter : _headquarters)
+                headquarter.on_update_time(time);
         }
     }
 }
 
 int main()
 {
+    // ֻcoutرstdioͬд
+    std::ios::sync_with_stdio(false);
+    warcraft::input_reader input(0);
     int M;
-    std::cin >> M;
+    input >> M;
     for (int i = 1; i <= M; ++i) {
-        std::cout << "Case:" << i << std::endl;
+        std::cout << "Case:" << i << '\n';
         int hp;
         std::array<int, 5> hp_warrior;
-        std::cin >> hp
+        input >> hp
             >> hp_warrior[0]
             >> hp_warrior[1]
             >> hp_warrior[2]
             >> hp_warrior[3]
             >> hp_warrior[4];
-        warcraft::game_controller controller(hp, 0, hp_warrior);
+        warcraft::game_controller controller(hp, hp_warrior);
         controller.run();
     }
     return 0;
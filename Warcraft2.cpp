@@ -2,8 +2,20 @@
 #include <vector>
 #include <array>
 #include <tuple>
-#include <any>
 #include <iomanip>
+#include <charconv>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cctype>
+#include <cerrno>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include <math.h>
 
 namespace warcraft {
@@ -16,7 +28,7 @@ namespace warcraft {
         stop_generate_warrior
     };
 
-    const std::string camp_name(camp_label camp) noexcept
+    constexpr std::string_view camp_name(camp_label camp) noexcept
     {
         switch (camp) {
             case camp_label::red:
@@ -36,173 +48,187 @@ namespace warcraft {
         return time % 60;
     }
 
-    class game_controller;
-
-    class game_object {
-    public:
-        virtual ~game_object() = default;
-        virtual void on_update_time(int new_time) {}
-    };
-
-    class warrior;
-
-    class city: public game_object {
-    public:
-        virtual ~city() = default;
+    // ʱʽhhhֱдʱַ
+    struct hour_stamp {
+        int time;
     };
 
-    constexpr int warrior_type_count = 5;
-
-    class headquarter: public city {
-    protected:
-        game_controller* _controller;
-
-        camp_label _camp;
-        int _health_point;
-        std::vector<std::unique_ptr<warrior>> _warriors; // RAII
-
-        int _last_generate_warrior = -1;
-        std::array<int, warrior_type_count> _warrior_record{ 0 };
-        bool _stopped = false;
-    public:
-        headquarter(camp_label camp, int health_point, game_controller* controller) noexcept
-            : _camp(camp), _health_point(health_point), _controller(controller)
-        {
+    std::ostream& operator<<(std::ostream& os, hour_stamp stamp)
+    {
+        char buffer[16], * end = buffer;
+        int h = hour(stamp.time);
+        if (h < 1000) {
+            *end++ = '0' + h / 100;
+            *end++ = '0' + h / 10 % 10;
+            *end++ = '0' + h % 10;
         }
-        virtual ~headquarter() = default;
-
-        virtual void on_update_time(int new_time) override;
-    protected:
-        void generate_warrior(int time);
-    };
-
+        else {
+            end = std::to_chars(buffer, buffer + sizeof(buffer), h).ptr;
+        }
+        return os.write(buffer, end - buffer);
+    }
 
-    class weapon {
+    // ȡ
+    // ͨļʱmmapӳ䣬򰴴ڴ棬from_chars
+    // binary_magicͷǶƸʽ֮ÿ4ֽС룬˳ıʽͬ
+    class input_reader {
+    private:
+        const char* _current = nullptr, * _end = nullptr;
+        // mmapʱȫ
+        std::vector<char> _buffer;
+        void* _mapping = nullptr;
+        std::size_t _mapping_size = 0;
+        bool _binary = false, _failed = false;
     public:
-        weapon(const char* name): name(name) {}
-        virtual ~weapon() = default;
+        constexpr static std::string_view binary_magic = "WCRB";
+        constexpr static std::size_t block_size = 1 << 20;
 
-        const char* name;
-    };
+        explicit input_reader(int fd);
+        input_reader(const input_reader&) = delete;
+        input_reader& operator=(const input_reader&) = delete;
+        ~input_reader();
 
-    class sword: public weapon {
-    public:
-        sword(): weapon("sword") {}
-        virtual ~sword() = default;
+        // ȡһʧʱvalueΪ0֮Ķȡʧ
+        input_reader& operator>>(int& value);
+        explicit operator bool() const noexcept { return !_failed; }
     };
 
-    class bomb: public weapon {
-    public:
-        bomb(): weapon("bomb") {}
-        virtual ~bomb() = default;
-    };
+    input_reader::input_reader(int fd)
+    {
+#ifndef _WIN32
+        struct stat info;
+        if (::fstat(fd, &info) == 0 and S_ISREG(info.st_mode) and info.st_size > 0) {
+            void* mapping = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                _mapping = mapping;
+                _mapping_size = info.st_size;
+                _current = static_cast<const char*>(mapping);
+                _end = _current + _mapping_size;
+            }
+        }
+#endif
+        if (!_mapping) {
+            std::size_t size = 0;
+            while (true) {
+                _buffer.resize(size + block_size);
+#ifdef _WIN32
+                auto count = ::_read(fd, _buffer.data() + size, static_cast<unsigned>(block_size));
+#else
+                auto count = ::read(fd, _buffer.data() + size, block_size);
+#endif
+                if (count < 0 and errno == EINTR)
+                    continue;
+                if (count <= 0)
+                    break;
+                size += count;
+            }
+            _buffer.resize(size);
+            _current = _buffer.data();
+            _end = _current + size;
+        }
+        if (static_cast<std::size_t>(_end - _current) >= binary_magic.size()
+            and std::string_view(_current, binary_magic.size()) == binary_magic) {
+            _binary = true;
+            _current += binary_magic.size();
+        }
+    }
 
-    class arrow: public weapon {
-    public:
-        arrow(): weapon("arrow") {}
-        virtual ~arrow() = default;
-    };
+    input_reader::~input_reader()
+    {
+#ifndef _WIN32
+        if (_mapping)
+            ::munmap(_mapping, _mapping_size);
+#endif
+    }
 
-    std::unique_ptr<weapon> get_weapon(int index)
+    input_reader& input_reader::operator>>(int& value)
     {
-        switch (index) {
-            case 0:
-                return std::make_unique<sword>();
-            case 1:
-                return std::make_unique<bomb>();
-            case 2:
-                return std::make_unique<arrow>();
-            default:
-                return nullptr;
+        value = 0;
+        if (_failed)
+            return *this;
+        if (_binary) {
+            if (_end - _current < 4) {
+                _failed = true;
+                return *this;
+            }
+            auto bytes = reinterpret_cast<const unsigned char*>(_current);
+            value = static_cast<std::int32_t>(bytes[0] | bytes[1] << 8 | bytes[2] << 16 | static_cast<std::uint32_t>(bytes[3]) << 24);
+            _current += 4;
+            return *this;
         }
+        while (_current != _end and std::isspace(static_cast<unsigned char>(*_current)))
+            ++_current;
+        auto [ptr, error] = std::from_chars(_current, _end, value);
+        if (error != std::errc()) {
+            _failed = true;
+            value = 0;
+            return *this;
+        }
+        _current = ptr;
+        return *this;
     }
 
+    class game_controller;
+
+    constexpr int warrior_type_count = 5;
 
-    class warrior {
+    class headquarter {
     protected:
+        game_controller* _controller;
+
         camp_label _camp;
         int _health_point;
-        int _id;
 
-        std::vector<std::unique_ptr<weapon>> _weapons;
+        int _last_generate_warrior = -1;
+        // ʿʿֻ¼
+        int _generated_count = 0;
+        std::array<int, warrior_type_count> _warrior_record{ 0 };
+        bool _stopped = false;
     public:
-        warrior(camp_label camp, int health_point, int id, const char* name, int weapon_num = 0) noexcept
-            : _camp(camp), _health_point(health_point), _id(id), name(name), _weapons(weapon_num)
+        headquarter(camp_label camp, int health_point, game_controller* controller) noexcept
+            : _controller(controller), _camp(camp), _health_point(health_point)
         {
         }
-        virtual ~warrior() = default;
-
-        const char* name;
-        camp_label camp() const noexcept { return _camp; }
-        int health_point() const noexcept { return _health_point; }
-        int id() const noexcept { return _id; }
 
-        virtual void show_additional_information() const noexcept {};
-    };
-
-    class dragon: public warrior {
-    private:
-        double _morale;
-    public:
-        dragon(camp_label camp, int health_point, int id, double morale) noexcept;
-        virtual ~dragon() = default;
-
-        virtual void show_additional_information() const noexcept override;
-    };
-
-    class ninja: public warrior {
-    public:
-        ninja(camp_label camp, int health_point, int id) noexcept;
-        virtual ~ninja() = default;
-
-        virtual void show_additional_information() const noexcept override;
-    };
-
-    class iceman: public warrior {
-    public:
-        iceman(camp_label camp, int health_point, int id) noexcept;
-        virtual ~iceman() = default;
-
-        virtual void show_additional_information() const noexcept override;
+        void on_update_time(int new_time);
+        // ңֱ˳ϴ֮deltaʿ֤߱Ԫ㹻
+        void generate_next_warrior(int time, int delta = 1);
+    protected:
+        void generate_warrior(int time);
     };
 
-    class lion: public warrior {
-    private:
-        int _loyalty;
-    public:
-        lion(camp_label camp, int health_point, int id, int loyalty) noexcept
-            : _loyalty(loyalty), warrior(camp, health_point, id, "lion")
-        {
-        }
-        virtual ~lion() = default;
 
-        virtual void show_additional_information() const noexcept override;
-    };
+    constexpr char warrior_name[warrior_type_count][7] = { "dragon", "ninja", "iceman", "lion", "wolf" };
+    constexpr char weapon_name[3][6] = { "sword", "bomb", "arrow" };
+    constexpr int red_order[warrior_type_count] = { 2, 3, 4, 1, 0 },
+        blue_order[warrior_type_count] = { 3, 0, 1, 2, 4 };
 
-    class wolf: public warrior {
-    public:
-        wolf(camp_label camp, int health_point, int id) noexcept
-            : warrior(camp, health_point, id, "wolf")
-        {
-        }
-        virtual ~wolf() = default;
-    };
-
-    std::unique_ptr<warrior> get_warrior(int index, camp_label camp, int health_point, int id, int left_hp)
+    // ʿĸϢ𡢱źֱֵʿ
+    // left_hpΪ˾ʣԪ
+    void show_additional_information(int index, int id, int health_point, int left_hp)
     {
         switch (index) {
-            case 0:
-                return std::make_unique<dragon>(camp, health_point, id, static_cast<double>(left_hp) / health_point);
-            case 1:
-                return std::make_unique<ninja>(camp, health_point, id);
-            case 2:
-                return std::make_unique<iceman>(camp, health_point, id);
-            case 3:
-                return std::make_unique<lion>(camp, health_point, id, left_hp);
-            case 4:
-                return std::make_unique<wolf>(camp, health_point, id);
+            case 0: { // dragon
+                double morale = static_cast<double>(left_hp) / health_point;
+                std::cout << "It has a " << weapon_name[id % 3]
+                    << ",and it's morale is "
+                    << std::fixed << std::setprecision(2) << std::round(morale * 100) / 100
+                    << '\n';
+                break;
+            }
+            case 1: // ninja
+                std::cout << "It has a " << weapon_name[id % 3]
+                    << " and a " << weapon_name[(id + 1) % 3]
+                    << '\n';
+                break;
+            case 2: // iceman
+                std::cout << "It has a " << weapon_name[id % 3] << '\n';
+                break;
+            case 3: // lion
+                std::cout << "It's loyalty is " << left_hp << '\n';
+                break;
             default:
-                return nullptr;
+                break;
         }
     }
 
@@ -210,15 +236,18 @@ namespace warcraft {
     private:
         const std::array<int, 5> _warrior_HP;
 
-        std::vector<std::unique_ptr<city>> _citys;
+        // ˫˾±ΪӪ
+        std::array<headquarter, 2> _headquarters;
 
         int _left_generating = 2;
+        // ʼʱ˫
+        int _full_cycles = 0;
     public:
-        game_controller(int base_HP, int city_count, const std::array<int, 5>& warrior_HP);
+        game_controller(int base_HP, const std::array<int, 5>& warrior_HP);
 
         int warrior_HP(int n) const { return _warrior_HP[n]; }
 
-        void send_message(game_message msg, std::any param = {});
+        void send_message(game_message msg) noexcept;
         void run();
     };
 
@@ -229,52 +258,57 @@ namespace warcraft {
                 generate_warrior(new_time);
                 break;
         }
-        city::on_update_time(new_time);
     }
 
     void headquarter::generate_warrior(int time)
     {
         if (_stopped) return;
-        static constexpr int red_order[] = { 2, 3, 4, 1, 0 },
-            blue_order[] = { 3, 0, 1, 2, 4 };
         const auto& order = (_camp == camp_label::red) ? red_order : blue_order;
         int delta_warrior_type = 1;
         for (; delta_warrior_type <= 5; ++delta_warrior_type)
             if (_health_point >= _controller->warrior_HP(order[(_last_generate_warrior + delta_warrior_type) % 5]))
                 break;
         if (delta_warrior_type == 6) {
-            std::cout << std::setw(3) << std::setfill('0') << hour(time) << ' '
-                << camp_name(_camp) << " headquarter stops making warriors" << std::endl;
+            std::cout << hour_stamp{ time } << ' '
+                << camp_name(_camp) << " headquarter stops making warriors" << '\n';
             _controller->send_message(game_message::stop_generate_warrior);
             _stopped = true;
             return;
         }
-        _last_generate_warrior = (_last_generate_warrior + delta_warrior_type) % 5;
+        generate_next_warrior(time, delta_warrior_type);
+    }
+
+    void headquarter::generate_next_warrior(int time, int delta)
+    {
+        const auto& order = (_camp == camp_label::red) ? red_order : blue_order;
+        _last_generate_warrior = (_last_generate_warrior + delta) % 5;
         int index = order[_last_generate_warrior];
-        int id = _warriors.size() + 1, hp = _controller->warrior_HP(index);
+        const auto& name = warrior_name[index];
+        int id = ++_generated_count, hp = _controller->warrior_HP(index);
         ++_warrior_record[index];
         _health_point -= hp;
-        _warriors.emplace_back(get_warrior(index, _camp, hp, id, _health_point));
-        const auto name = _warriors.back()->name;
-        std::cout << std::setw(3) << std::setfill('0') << hour(time) << ' '
+        std::cout << hour_stamp{ time } << ' '
             << camp_name(_camp) << ' ' << name << ' '
             << id << " born with strength " << hp << ','
             << _warrior_record[index] << ' ' << name << " in "
-            << camp_name(_camp) << " headquarter" << std::endl;
-        _warriors.back()->show_additional_information();
+            << camp_name(_camp) << " headquarter" << '\n';
+        show_additional_information(index, id, hp, _health_point);
     }
 
-    game_controller::game_controller(int base_HP, int city_count, const std::array<int, 5>& warrior_HP)
+    game_controller::game_controller(int base_HP, const std::array<int, 5>& warrior_HP)
         : _warrior_HP(warrior_HP),
-        _citys(city_count + 2)
+        _headquarters{ { headquarter(camp_label::red, base_HP, this), headquarter(camp_label::blue, base_HP, this) } }
     {
-        _citys.front() = std::make_unique<headquarter>(camp_label::red, base_HP, this);
-        _citys.back() = std::make_unique<headquarter>(camp_label::blue, base_HP, this);
-        for (int i = 1; i <= city_count; ++i)
-            _citys[i] = std::make_unique<city>();
+        // ԪʿܺʱСʱһθһκһ
+        // ˫ĳʼԪͬҲͬ
+        long long cycle_HP = 0;
+        for (int hp : warrior_HP)
+            cycle_HP += hp;
+        if (cycle_HP > 0 and base_HP > 0)
+            _full_cycles = base_HP / cycle_HP;
     }
 
-    void game_controller::send_message(game_message msg, std::any param)
+    void game_controller::send_message(game_message msg) noexcept
     {
         switch (msg) {
             case game_message::stop_generate_warrior:
@@ -287,74 +321,39 @@ namespace warcraft {
 
     void game_controller::run()
     {
+        auto& [red, blue] = _headquarters;
         int time = 0;
-        for (; _left_generating > 0; time += 60) {
-            for (auto& city : _citys) {
-                city->on_update_time(time);
+        // ׶ΣÿСʱ˫ֱ˳еһ֣Ҫ
+        for (int cycle = 0; cycle < _full_cycles; ++cycle)
+            for (int k = 0; k < warrior_type_count; ++k, time += 60) {
+                red.generate_next_warrior(time);
+                blue.generate_next_warrior(time);
             }
+        for (; _left_generating > 0; time += 60) {
+            for (auto& headquarter : _headquarters)
+                headquarter.on_update_time(time);
         }
     }
-
-    dragon::dragon(camp_label camp, int health_point, int id, double morale) noexcept
-        : _morale(morale), warrior(camp, health_point, id, "dragon", 1)
-    {
-        _weapons[0] = get_weapon(id % 3);
-    }
-
-    void dragon::show_additional_information() const noexcept
-    {
-        std::cout << "It has a " << _weapons[0]->name
-            << ",and it's morale is "
-            << std::fixed << std::setprecision(2) << std::round(_morale * 100) / 100
-            << std::endl;
-    }
-
-    ninja::ninja(camp_label camp, int health_point, int id) noexcept
-        : warrior(camp, health_point, id, "ninja", 2)
-    {
-        _weapons[0] = get_weapon(id % 3);
-        _weapons[1] = get_weapon((id + 1) % 3);
-    }
-
-    void ninja::show_additional_information() const noexcept
-    {
-        std::cout << "It has a " << _weapons[0]->name
-            << " and a " << _weapons[1]->name
-            << std::endl;
-    }
-
-    iceman::iceman(camp_label camp, int health_point, int id) noexcept
-        : warrior(camp, health_point, id, "iceman", 1)
-    {
-        _weapons[0] = get_weapon(id % 3);
-    }
-
-    void iceman::show_additional_information() const noexcept
-    {
-        std::cout << "It has a " << _weapons[0]->name << std::endl;
-    }
-
-    void lion::show_additional_information() const noexcept
-    {
-        std::cout << "It's loyalty is " << _loyalty << std::endl;
-    }
 }
 
 int main()
 {
+    // ֻcoutرstdioͬд
+    std::ios::sync_with_stdio(false);
+    warcraft::input_reader input(0);
     int M;
-    std::cin >> M;
+    input >> M;
     for (int i = 1; i <= M; ++i) {
-        std::cout << "Case:" << i << std::endl;
+        std::cout << "Case:" << i << '\n';
         int hp;
         std::array<int, 5> hp_warrior;
-        std::cin >> hp
+        input >> hp
             >> hp_warrior[0]
             >> hp_warrior[1]
             >> hp_warrior[2]
             >> hp_warrior[3]
             >> hp_warrior[4];
-        warcraft::game_controller controller(hp, 0, hp_warrior);
+        warcraft::game_controller controller(hp, hp_warrior);
         controller.run();
     }
     return 0;
@@ -7,13 +7,20 @@
 *  city, warrior(), weapon()ֱ
 *  ໹иԵ࣬ʾĶ
 *  
-*  game_controller->city->warrior->weapon
+*  game_controller->city, game_controller->marching_column->warrior
 *  ͷߵұߵunique pointer
-*  ʱֻһgame_controller(ģʽ)
+*  ÿӪʿһ(marching_column)УͨŲеʿ
+*  ʿcontrollerڴз䣬controllerʱͷ
+*  󲻱ƣֻʱӪͱƴ
+*  citywarriorcontrollerָ룬ʹȫ״̬
+*  ͬһ̡ͬһ߳пͬʱcontroller
 *  Ϸgame_controller::run()
 *  run()ִʵʶֻcityʱµϢ
 *  ʱµϢĶ
 *  ÿͨon_update_timeضʱʱԼĶ
+*  ʱgame_schedulerǼԼĵķ
+*  run()ֻڵǼǹʱ̷Ϣ·ʱ
+*  Ϸ¼ͨcontrollerevent_busÿʱ̽ʱַ
 *  
 *  ʿǰϷֹͣcontrollerִ
 *  ʿսڵcityִ
@@ -23,12 +30,48 @@
 #include <iostream>
 #include <vector>
 #include <array>
+#include <queue>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <cstdint>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <charconv>
+#include <cerrno>
+#include <utility>
+#include <tuple>
+#include <variant>
+#include <type_traits>
+#include <limits>
+#include <chrono>
+#include <memory_resource>
+#include <string_view>
 #include <stdexcept>
-#include <any>
 #include <iomanip>
 #include <sstream>
 #include <math.h>
 #include <algorithm>
+#include <iterator>
+#include <cctype>
+#include <fcntl.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 namespace warcraft
 {
@@ -41,11 +84,187 @@ namespace warcraft
 		blue = 1
 	};
 
-	enum class game_message : int8_t {
-		game_over
+	// ֵ࣬Ϊ
+	enum class weapon_kind : int8_t {
+		sword = 0,
+		bomb = 1,
+		arrow = 2
 	};
 
-	std::string camp_name(camp_label camp) noexcept
+	// ʿֵ࣬Ϊʿ
+	enum class warrior_kind : int8_t {
+		dragon = 0,
+		ninja = 1,
+		iceman = 2,
+		lion = 3,
+		wolf = 4
+	};
+
+	// Ĺ̶ԣȷ
+	template<weapon_kind kind>
+	struct weapon_traits;
+
+	template<>
+	struct weapon_traits<weapon_kind::sword> {
+		constexpr static std::string_view name = "sword";
+		// ;-1ʾ;
+		constexpr static int durability = -1;
+		// Ϊ߹force_rate/10
+		constexpr static int force_rate = 2;
+	};
+
+	template<>
+	struct weapon_traits<weapon_kind::bomb> {
+		constexpr static std::string_view name = "bomb";
+		constexpr static int durability = 1;
+		constexpr static int force_rate = 4;
+	};
+
+	template<>
+	struct weapon_traits<weapon_kind::arrow> {
+		constexpr static std::string_view name = "arrow";
+		constexpr static int durability = 2;
+		constexpr static int force_rate = 3;
+	};
+
+	constexpr std::uint64_t minute_bit(int minute) noexcept { return std::uint64_t(1) << minute; }
+
+	// ʿĹ̶ԣȷ
+	// hurt_by_own_bombʾʹbombʱԼǷ
+	// active_minutesÿСʱԼжҪյʱµķӣʿڵ55ӱ
+	template<warrior_kind kind>
+	struct warrior_traits;
+
+	template<>
+	struct warrior_traits<warrior_kind::dragon> {
+		constexpr static std::string_view name = "dragon";
+		constexpr static bool hurt_by_own_bomb = true;
+		// սнУҪʱ
+		constexpr static std::uint64_t active_minutes = minute_bit(55);
+	};
+
+	template<>
+	struct warrior_traits<warrior_kind::ninja> {
+		constexpr static std::string_view name = "ninja";
+		// ninjaʹbombʹԼ
+		constexpr static bool hurt_by_own_bomb = false;
+		constexpr static std::uint64_t active_minutes = minute_bit(55);
+	};
+
+	template<>
+	struct warrior_traits<warrior_kind::iceman> {
+		constexpr static std::string_view name = "iceman";
+		constexpr static bool hurt_by_own_bomb = true;
+		constexpr static std::uint64_t active_minutes = minute_bit(55);
+	};
+
+	template<>
+	struct warrior_traits<warrior_kind::lion> {
+		constexpr static std::string_view name = "lion";
+		constexpr static bool hurt_by_own_bomb = true;
+		// 5
+		constexpr static std::uint64_t active_minutes = minute_bit(5) | minute_bit(55);
+	};
+
+	template<>
+	struct warrior_traits<warrior_kind::wolf> {
+		constexpr static std::string_view name = "wolf";
+		constexpr static bool hurt_by_own_bomb = true;
+		// 35
+		constexpr static std::uint64_t active_minutes = minute_bit(35) | minute_bit(55);
+	};
+
+	// ʱתΪڳfĲΪstd::integral_constant
+	template<class F>
+	constexpr decltype(auto) visit_kind(weapon_kind kind, F&& f)
+	{
+		switch (kind) {
+		case weapon_kind::sword:
+			return f(std::integral_constant<weapon_kind, weapon_kind::sword>{});
+		case weapon_kind::bomb:
+			return f(std::integral_constant<weapon_kind, weapon_kind::bomb>{});
+		default:
+			return f(std::integral_constant<weapon_kind, weapon_kind::arrow>{});
+		}
+	}
+
+	template<class F>
+	constexpr decltype(auto) visit_kind(warrior_kind kind, F&& f)
+	{
+		switch (kind) {
+		case warrior_kind::dragon:
+			return f(std::integral_constant<warrior_kind, warrior_kind::dragon>{});
+		case warrior_kind::ninja:
+			return f(std::integral_constant<warrior_kind, warrior_kind::ninja>{});
+		case warrior_kind::iceman:
+			return f(std::integral_constant<warrior_kind, warrior_kind::iceman>{});
+		case warrior_kind::lion:
+			return f(std::integral_constant<warrior_kind, warrior_kind::lion>{});
+		default:
+			return f(std::integral_constant<warrior_kind, warrior_kind::wolf>{});
+		}
+	}
+
+	constexpr std::string_view weapon_name(weapon_kind kind) noexcept
+	{
+		return visit_kind(kind, [](auto k) { return weapon_traits<k()>::name; });
+	}
+
+	// ߹Ϊholder_forceʱĹ
+	constexpr int weapon_force(weapon_kind kind, int holder_force) noexcept
+	{
+		return visit_kind(kind, [=](auto k) { return holder_force * weapon_traits<k()>::force_rate / 10; });
+	}
+
+	constexpr std::string_view warrior_type_name(warrior_kind kind) noexcept
+	{
+		return visit_kind(kind, [](auto k) { return warrior_traits<k()>::name; });
+	}
+
+	constexpr int initial_durability(weapon_kind kind) noexcept
+	{
+		return visit_kind(kind, [](auto k) { return weapon_traits<k()>::durability; });
+	}
+
+	constexpr bool hurt_by_own_bomb(warrior_kind kind) noexcept
+	{
+		return visit_kind(kind, [](auto k) { return warrior_traits<k()>::hurt_by_own_bomb; });
+	}
+
+	constexpr std::uint64_t active_minutes(warrior_kind kind) noexcept
+	{
+		return visit_kind(kind, [](auto k) { return warrior_traits<k()>::active_minutes; });
+	}
+
+	// ʿļϣiλʾΪi
+	constexpr unsigned warrior_kind_bit(warrior_kind kind) noexcept { return 1u << static_cast<int>(kind); }
+	constexpr unsigned all_warrior_kinds = (1u << warrior_type_count) - 1;
+
+	// ÿСʱͨԼжķӣǰ(10)ս(40)
+	constexpr std::uint64_t city_active_minutes = minute_bit(10) | minute_bit(40);
+
+	// minuteҪʵͨеʿ
+	// ԼжʱΪȫֻࣻЩʿĳУΪ0ʱҪκͨ
+	constexpr unsigned active_warrior_kinds(int minute) noexcept
+	{
+		if (city_active_minutes >> minute & 1)
+			return all_warrior_kinds;
+		unsigned kinds = 0;
+		for (int index = 0; index < warrior_type_count; ++index)
+			if (active_minutes(static_cast<warrior_kind>(index)) >> minute & 1)
+				kinds |= warrior_kind_bit(static_cast<warrior_kind>(index));
+		return kinds;
+	}
+
+	// սģⷽʽ
+	enum class fight_engine : int8_t {
+		// ͨʿ麯غģ
+		classic,
+		// ˫װfight_stateģ⣬ڽ׶κֱ
+		soa
+	};
+
+	constexpr std::string_view camp_name(camp_label camp) noexcept
 	{
 		switch (camp) {
 		case camp_label::red:
@@ -65,18 +284,6 @@ namespace warcraft
 		}
 	}
 
-	const std::string weapon_name(int index) noexcept
-	{
-		switch (index) {
-		case 0:
-			return "sword";
-		case 1:
-			return "bomb";
-		case 2:
-			return "arrow";
-		}
-	}
-
 	camp_label enemy_camp(camp_label camp) noexcept
 	{
 		switch (camp) {
@@ -98,6 +305,7 @@ namespace warcraft
 	}
 
 	// ʱʽhhh:mm
+	// ÿεöҪostringstreamϷ¼game_timeֻܶԱ
 	std::string time_to_str(int time) noexcept
 	{
 		std::ostringstream oss;
@@ -107,69 +315,1325 @@ namespace warcraft
 		return oss.str();
 	}
 
+	// 00~99λֱiռ[2i, 2i + 1]
+	constexpr auto two_digits = [] {
+		std::array<char, 200> table{};
+		for (int i = 0; i < 100; ++i) {
+			table[2 * i] = '0' + i / 10;
+			table[2 * i + 1] = '0' + i % 10;
+		}
+		return table;
+	}();
+
+	// ʱʽ󳤶
+	constexpr std::size_t max_time_length = 16;
+
+	// ʱʽhhh:mmдbufferдλ
+	// ڴ棬bufferҪmax_time_lengthֽ
+	char* format_time(char* buffer, int time) noexcept
+	{
+		int h = hour(time), m = minute(time);
+		if (h < 1000) {
+			*buffer++ = '0' + h / 100;
+			std::memcpy(buffer, &two_digits[h % 100 * 2], 2);
+			buffer += 2;
+		}
+		else {
+			buffer = std::to_chars(buffer, buffer + max_time_length, h).ptr;
+		}
+		*buffer++ = ':';
+		std::memcpy(buffer, &two_digits[m * 2], 2);
+		return buffer + 2;
+	}
+
+	// ʱʱʹãout << game_time{ time }
+	struct game_time {
+		int time;
+	};
+
+	// Ϸ¼Ŀ
+	// һ黺дʱֱӸƵУռ䲻ʱŵoverflow
+	class output_sink {
+	protected:
+		char* _begin = nullptr;
+		char* _current = nullptr;
+		char* _end = nullptr;
+
+		// ʣռ䲻sizeֽʱãغsizeֽڵĿռ
+		virtual void overflow(std::size_t size) = 0;
+	public:
+		virtual ~output_sink() = default;
+
+		void write(const char* data, std::size_t size);
+		virtual void flush() {}
+
+		output_sink& operator<<(char ch);
+		output_sink& operator<<(int value);
+		output_sink& operator<<(game_time time);
+		output_sink& operator<<(std::string_view str) { write(str.data(), str.size()); return *this; }
+		output_sink& operator<<(const std::string& str) { return *this << std::string_view(str); }
+		// ַĳڱȷ
+		template<std::size_t N>
+		output_sink& operator<<(const char(&str)[N]) { write(str, N - 1); return *this; }
+	};
+
+	// дڴ棬ÿϷһģʽͰ
+	class memory_sink : public output_sink {
+	private:
+		std::unique_ptr<char[]> _buffer;
+	protected:
+		virtual void overflow(std::size_t size) override;
+	public:
+		memory_sink() = default;
+		memory_sink(memory_sink&& other) noexcept;
+		virtual ~memory_sink() = default;
+
+		std::string_view str() const noexcept { return { _begin, static_cast<std::size_t>(_current - _begin) }; }
+		void clear() noexcept { _current = _begin; }
+	};
+
+	// 󻺳ʱֱwrite(2)дļ
+	class fd_sink : public output_sink {
+	private:
+		int _fd;
+		bool _owns_fd;
+		// һдʧʱerrnoΪ0ʱûʧܡʧܺд
+		int _error = 0;
+		std::unique_ptr<char[]> _buffer;
+	protected:
+		virtual void overflow(std::size_t size) override;
+	public:
+		constexpr static std::size_t default_capacity = 1 << 20;
+
+		explicit fd_sink(int fd, bool owns_fd = false, std::size_t capacity = default_capacity);
+		// ļʧʱ׳쳣
+		explicit fd_sink(const char* path, std::size_t capacity = default_capacity);
+		virtual ~fd_sink();
+
+		virtual void flush() override;
+		int error() const noexcept { return _error; }
+	};
+
+	void output_sink::write(const char* data, std::size_t size)
+	{
+		if (static_cast<std::size_t>(_end - _current) < size)
+			overflow(size);
+		std::memcpy(_current, data, size);
+		_current += size;
+	}
+
+	output_sink& output_sink::operator<<(char ch)
+	{
+		if (_current == _end)
+			overflow(1);
+		*_current++ = ch;
+		return *this;
+	}
+
+	output_sink& output_sink::operator<<(int value)
+	{
+		constexpr std::size_t max_length = 11;
+		if (static_cast<std::size_t>(_end - _current) < max_length)
+			overflow(max_length);
+		_current = std::to_chars(_current, _end, value).ptr;
+		return *this;
+	}
+
+	output_sink& output_sink::operator<<(game_time time)
+	{
+		if (static_cast<std::size_t>(_end - _current) < max_time_length)
+			overflow(max_time_length);
+		_current = format_time(_current, time.time);
+		return *this;
+	}
+
+	void memory_sink::overflow(std::size_t size)
+	{
+		std::size_t used = _current - _begin,
+			capacity = std::max<std::size_t>({ 2 * static_cast<std::size_t>(_end - _begin), used + size, 4096 });
+		auto buffer = std::make_unique<char[]>(capacity);
+		if (used)
+			std::memcpy(buffer.get(), _begin, used);
+		_buffer = std::move(buffer);
+		_begin = _buffer.get();
+		_current = _begin + used;
+		_end = _begin + capacity;
+	}
+
+	memory_sink::memory_sink(memory_sink&& other) noexcept
+		: _buffer(std::move(other._buffer))
+	{
+		_begin = std::exchange(other._begin, nullptr);
+		_current = std::exchange(other._current, nullptr);
+		_end = std::exchange(other._end, nullptr);
+	}
+
+	fd_sink::fd_sink(int fd, bool owns_fd, std::size_t capacity)
+		: _fd(fd), _owns_fd(owns_fd), _buffer(std::make_unique<char[]>(capacity))
+	{
+		_begin = _current = _buffer.get();
+		_end = _begin + capacity;
+	}
+
+#ifdef _WIN32
+	fd_sink::fd_sink(const char* path, std::size_t capacity)
+		: fd_sink(::_open(path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644), true, capacity)
+#else
+	fd_sink::fd_sink(const char* path, std::size_t capacity)
+		: fd_sink(::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644), true, capacity)
+#endif
+	{
+		if (_fd < 0)
+			throw std::runtime_error(std::string("Cannot open ") + path);
+	}
+
+	fd_sink::~fd_sink()
+	{
+		flush();
+		if (_owns_fd) {
+#ifdef _WIN32
+			::_close(_fd);
+#else
+			::close(_fd);
+#endif
+		}
+	}
+
+	// dataеsizeֽȫдfd
+	// return: ɹʱΪ0Ϊerrno
+	int write_fd(int fd, const char* data, std::size_t size)
+	{
+		while (size > 0) {
+#ifdef _WIN32
+			auto written = ::_write(fd, data, static_cast<unsigned>(size));
+#else
+			auto written = ::write(fd, data, size);
+#endif
+			if (written < 0) {
+				if (errno == EINTR)
+					continue;
+				return errno;
+			}
+			data += written;
+			size -= written;
+		}
+		return 0;
+	}
+
+	void fd_sink::flush()
+	{
+		if (!_error)
+			_error = write_fd(_fd, _begin, _current - _begin);
+		_current = _begin;
+	}
+
+	// ׼ʱдʣ
+	fd_sink& standard_output()
+	{
+		static fd_sink sink(1);
+		return sink;
+	}
+
+	// дʧʱڱ׼ԭwhat
+	// return: Ƿдʧ
+	bool report_write_error(const fd_sink& sink, const char* what)
+	{
+		if (!sink.error())
+			return false;
+		std::cerr << "Cannot write " << what << ": " << std::strerror(sink.error()) << std::endl;
+		return true;
+	}
+
+	void fd_sink::overflow(std::size_t size)
+	{
+		flush();
+		if (static_cast<std::size_t>(_end - _begin) < size) {
+			_buffer = std::make_unique<char[]>(size);
+			_begin = _current = _buffer.get();
+			_end = _begin + size;
+		}
+	}
+
+	// ȡ
+	// ͨļʱmmapӳ䣬򰴴ڴ棬from_chars
+	// binary_magicͷǶƸʽ֮ÿ4ֽС룬˳ıʽͬ
+	class input_reader {
+	private:
+		const char* _current = nullptr, * _end = nullptr;
+		// mmapʱȫ
+		std::vector<char> _buffer;
+		void* _mapping = nullptr;
+		std::size_t _mapping_size = 0;
+		bool _binary = false, _failed = false;
+	public:
+		constexpr static std::string_view binary_magic = "WCRB";
+		constexpr static std::size_t block_size = 1 << 20;
+
+		explicit input_reader(int fd);
+		input_reader(const input_reader&) = delete;
+		input_reader& operator=(const input_reader&) = delete;
+		~input_reader();
+
+		// ȡһʧʱvalueΪ0֮Ķȡʧ
+		input_reader& operator>>(int& value);
+		explicit operator bool() const noexcept { return !_failed; }
+		// δȡԭʼ
+		std::string_view rest() const noexcept { return { _current, static_cast<std::size_t>(_end - _current) }; }
+	};
+
+	input_reader::input_reader(int fd)
+	{
+#ifndef _WIN32
+		struct stat info;
+		if (::fstat(fd, &info) == 0 and S_ISREG(info.st_mode) and info.st_size > 0) {
+			void* mapping = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (mapping != MAP_FAILED) {
+				_mapping = mapping;
+				_mapping_size = info.st_size;
+				_current = static_cast<const char*>(mapping);
+				_end = _current + _mapping_size;
+			}
+		}
+#endif
+		if (!_mapping) {
+			std::size_t size = 0;
+			while (true) {
+				_buffer.resize(size + block_size);
+#ifdef _WIN32
+				auto count = ::_read(fd, _buffer.data() + size, static_cast<unsigned>(block_size));
+#else
+				auto count = ::read(fd, _buffer.data() + size, block_size);
+#endif
+				if (count < 0 and errno == EINTR)
+					continue;
+				if (count <= 0)
+					break;
+				size += count;
+			}
+			_buffer.resize(size);
+			_current = _buffer.data();
+			_end = _current + size;
+		}
+		if (static_cast<std::size_t>(_end - _current) >= binary_magic.size()
+			and std::string_view(_current, binary_magic.size()) == binary_magic) {
+			_binary = true;
+			_current += binary_magic.size();
+		}
+	}
+
+	input_reader::~input_reader()
+	{
+#ifndef _WIN32
+		if (_mapping)
+			::munmap(_mapping, _mapping_size);
+#endif
+	}
+
+	input_reader& input_reader::operator>>(int& value)
+	{
+		value = 0;
+		if (_failed)
+			return *this;
+		if (_binary) {
+			if (_end - _current < 4) {
+				_failed = true;
+				return *this;
+			}
+			auto bytes = reinterpret_cast<const unsigned char*>(_current);
+			value = static_cast<std::int32_t>(bytes[0] | bytes[1] << 8 | bytes[2] << 16 | static_cast<std::uint32_t>(bytes[3]) << 24);
+			_current += 4;
+			return *this;
+		}
+		while (_current != _end and std::isspace(static_cast<unsigned char>(*_current)))
+			++_current;
+		auto [ptr, error] = std::from_chars(_current, _end, value);
+		if (error != std::errc()) {
+			_failed = true;
+			value = 0;
+			return *this;
+		}
+		_current = ptr;
+		return *this;
+	}
+
+	// յĶƱ룬ͬ4ֽС
+	class snapshot_writer {
+	private:
+		std::string& _data;
+	public:
+		explicit snapshot_writer(std::string& data) noexcept : _data(data) {}
+
+		snapshot_writer& operator<<(int value);
+		// 8ֽڵλʾд룬غȫͬ
+		snapshot_writer& operator<<(double value);
+	};
+
+	// ȡsnapshot_writerдݣݲʱ׳std::runtime_error
+	class snapshot_reader {
+	private:
+		std::string_view _data;
+	public:
+		explicit snapshot_reader(std::string_view data) noexcept : _data(data) {}
+
+		bool empty() const noexcept { return _data.empty(); }
+		snapshot_reader& operator>>(int& value);
+		snapshot_reader& operator>>(double& value);
+	};
+
+	snapshot_writer& snapshot_writer::operator<<(int value)
+	{
+		auto bits = static_cast<std::uint32_t>(value);
+		for (int shift = 0; shift < 32; shift += 8)
+			_data.push_back(static_cast<char>(bits >> shift & 0xff));
+		return *this;
+	}
+
+	snapshot_writer& snapshot_writer::operator<<(double value)
+	{
+		std::uint64_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return *this << static_cast<int>(bits & 0xffffffff) << static_cast<int>(bits >> 32);
+	}
+
+	snapshot_reader& snapshot_reader::operator>>(int& value)
+	{
+		if (_data.size() < 4)
+			throw std::runtime_error("Unexpected end of data");
+		auto bytes = reinterpret_cast<const unsigned char*>(_data.data());
+		value = static_cast<std::int32_t>(bytes[0] | bytes[1] << 8 | bytes[2] << 16 | static_cast<std::uint32_t>(bytes[3]) << 24);
+		_data.remove_prefix(4);
+		return *this;
+	}
+
+	snapshot_reader& snapshot_reader::operator>>(double& value)
+	{
+		int low, high;
+		*this >> low >> high;
+		std::uint64_t bits = static_cast<std::uint32_t>(low) | static_cast<std::uint64_t>(static_cast<std::uint32_t>(high)) << 32;
+		std::memcpy(&value, &bits, sizeof(value));
+		return *this;
+	}
+
+	// memory_resourceзĶɾ
+	// ֻѿռ仹memory_resource
+	struct pool_deleter {
+		std::pmr::memory_resource* memory = nullptr;
+		std::size_t size = 0, align = 0;
+
+		template<class T>
+		void operator()(T* object) const noexcept
+		{
+			object->~T();
+			memory->deallocate(object, size, align);
+		}
+	};
+
+	template<class T>
+	using pool_ptr = std::unique_ptr<T, pool_deleter>;
+
+	// memoryйT͵Ķɾ¼ʵ͵ĴС԰ȫתΪָ
+	template<class T, class... Args>
+	pool_ptr<T> make_pooled(std::pmr::memory_resource* memory, Args&&... args)
+	{
+		void* space = memory->allocate(sizeof(T), alignof(T));
+		try {
+			return pool_ptr<T>(new (space) T(std::forward<Args>(args)...), { memory, sizeof(T), alignof(T) });
+		}
+		catch (...) {
+			memory->deallocate(space, sizeof(T), alignof(T));
+			throw;
+		}
+	}
+
+	// ȵ·ͳ
+	// ʱWARCRAFT_PROFILEãprofile_timerprofile_countǿղκδ
+	// ݰ̷ֱ߳ۼӣ߳̽ʱϲ
+	enum class profile_phase : int {
+		generate,   // headquarter::generate_warrior
+		march,      // game_controller::warrior_move_forward
+		snatch,     // wolf::snatch
+		fight,      // city::fight
+		report,     // warrior::show_weapon
+		cleanup,    // ͷ_warrior_to_cleanеʿ
+		count
+	};
+
+	enum class profile_counter : int {
+		warriors_born,
+		fights,
+		// غģĻغڽ׶ֱĲֲ
+		fight_rounds,
+		weapon_uses,
+		// ڽ׶Ρֱս
+		periodic_fights,
+		weapons_snatched,
+		warriors_cleaned,
+		count
+	};
+
+	constexpr int profile_phase_count = static_cast<int>(profile_phase::count);
+	constexpr int profile_counter_count = static_cast<int>(profile_counter::count);
+
+#ifdef WARCRAFT_PROFILE
+	struct profile_data {
+		std::array<std::int64_t, profile_phase_count> calls{}, nanoseconds{};
+		std::array<std::int64_t, profile_counter_count> counters{};
+
+		void merge(const profile_data& other) noexcept
+		{
+			for (int i = 0; i < profile_phase_count; ++i) {
+				calls[i] += other.calls[i];
+				nanoseconds[i] += other.nanoseconds[i];
+			}
+			for (int i = 0; i < profile_counter_count; ++i)
+				counters[i] += other.counters[i];
+		}
+	};
+
+	class profiler {
+	private:
+		inline static std::mutex _mutex;
+		// ѽ̵߳ĺϼ
+		inline static profile_data _finished;
+		// ߳̽ʱѱ̵߳ݲ_finished
+		struct thread_data : profile_data {
+			~thread_data()
+			{
+				std::lock_guard lock(_mutex);
+				_finished.merge(*this);
+			}
+		};
+		inline static thread_local thread_data _local;
+	public:
+		static profile_data& local() noexcept { return _local; }
+		// ѽ߳뵱ǰ̵߳ĺϼƣͳ߳ǰҪȽ
+		static profile_data total()
+		{
+			std::lock_guard lock(_mutex);
+			auto result = _finished;
+			result.merge(_local);
+			return result;
+		}
+		static void reset()
+		{
+			std::lock_guard lock(_mutex);
+			_finished = {};
+			static_cast<profile_data&>(_local) = {};
+		}
+	};
+
+	// ӹ쵽ʱphase
+	class profile_timer {
+	private:
+		profile_phase _phase;
+		std::chrono::steady_clock::time_point _start;
+	public:
+		explicit profile_timer(profile_phase phase) noexcept : _phase(phase), _start(std::chrono::steady_clock::now()) {}
+		profile_timer(const profile_timer&) = delete;
+		profile_timer& operator=(const profile_timer&) = delete;
+		~profile_timer()
+		{
+			auto& data = profiler::local();
+			int index = static_cast<int>(_phase);
+			++data.calls[index];
+			data.nanoseconds[index] += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count();
+		}
+	};
+
+	inline void profile_count(profile_counter counter, std::int64_t value = 1) noexcept
+	{
+		profiler::local().counters[static_cast<int>(counter)] += value;
+	}
+
+	// ׶εĵôʱ͸֮ͳ
+	void profile_report(std::ostream& out)
+	{
+		static constexpr const char* phase_names[profile_phase_count] = { "generate", "march", "snatch", "fight", "report", "cleanup" };
+		static constexpr const char* counter_names[profile_counter_count] = {
+			"warriors born", "fights", "fight rounds", "weapon uses", "periodic fights", "weapons snatched", "warriors cleaned" };
+		auto data = profiler::total();
+		profiler::reset();
+		std::int64_t total_nanoseconds = 0;
+		for (auto nanoseconds : data.nanoseconds)
+			total_nanoseconds += nanoseconds;
+
+		out << std::fixed << std::setprecision(1)
+			<< std::left << std::setw(10) << "phase" << std::right
+			<< std::setw(14) << "calls" << std::setw(12) << "ms" << std::setw(10) << "ns/call" << std::setw(8) << "share" << '\n';
+		for (int i = 0; i < profile_phase_count; ++i)
+			out << std::left << std::setw(10) << phase_names[i] << std::right
+				<< std::setw(14) << data.calls[i]
+				<< std::setw(12) << data.nanoseconds[i] / 1e6
+				<< std::setw(10) << (data.calls[i] ? static_cast<double>(data.nanoseconds[i]) / data.calls[i] : 0.0)
+				<< std::setw(7) << (total_nanoseconds ? 100.0 * data.nanoseconds[i] / total_nanoseconds : 0.0) << '%' << '\n';
+		for (int i = 0; i < profile_counter_count; ++i)
+			out << std::left << std::setw(18) << counter_names[i] << std::right << std::setw(14) << data.counters[i] << '\n';
+		auto counter = [&data](profile_counter counter) { return static_cast<double>(data.counters[static_cast<int>(counter)]); };
+		if (counter(profile_counter::fights) > 0)
+			out << "rounds per fight  " << std::setw(14) << counter(profile_counter::fight_rounds) / counter(profile_counter::fights) << '\n';
+		if (counter(profile_counter::fight_rounds) > 0)
+			out << "weapons per round " << std::setw(14) << counter(profile_counter::weapon_uses) / counter(profile_counter::fight_rounds) << '\n';
+	}
+#else
+	class profile_timer {
+	public:
+		explicit profile_timer(profile_phase) noexcept {}
+	};
+
+	inline void profile_count(profile_counter, std::int64_t = 1) noexcept {}
+#endif
+
 	// ϷĹͬ࣬
 	class game_object {
 	public:
-		game_object(const std::string& name) noexcept : name(name) {}
 		virtual ~game_object() = 0;
 		virtual void on_update_time(int new_time) {}
+	};
+
+	// ¼
+	// ǼÿСʱԼĵķӣʱ˳һ¼ʱ
+	// ͬһֻǼһΣ60ʱ
+	class game_scheduler {
+	private:
+		std::priority_queue<int, std::vector<int>, std::greater<int>> _events;
+		// ѵǼǵķӣiλʾi
+		std::uint64_t _subscribed = 0;
+		// ǰڴʱ
+		int _now = -1;
+	public:
+		void subscribe(int minute);
+		// ǼminutesеÿһӣѵǼʱֻһж
+		void subscribe_minutes(std::uint64_t minutes);
+
+		bool empty() const noexcept { return _events.empty(); }
+		int next_time() const noexcept { return _events.top(); }
+		// ȡһʱ̣һСʱ·
+		int pop();
+
+		// գǰʱ̡ѵǼǵķӺͶеʱ
+		void save(snapshot_writer& out) const;
+		void load(snapshot_reader& in);
+	};
+
+	// һϷ
+	struct game_config {
+		int base_HP, city_count, lion_loyalty_reduce, end_time;
+		std::array<int, warrior_type_count> warrior_HP, warrior_force;
+	};
+
+	// ˳ͬ
+	snapshot_writer& operator<<(snapshot_writer& out, const game_config& config)
+	{
+		out << config.base_HP << config.city_count << config.lion_loyalty_reduce << config.end_time;
+		for (int hp : config.warrior_HP)
+			out << hp;
+		for (int force : config.warrior_force)
+			out << force;
+		return out;
+	}
+
+	snapshot_reader& operator>>(snapshot_reader& in, game_config& config)
+	{
+		in >> config.base_HP >> config.city_count >> config.lion_loyalty_reduce >> config.end_time;
+		for (int& hp : config.warrior_HP)
+			in >> hp;
+		for (int& force : config.warrior_force)
+			in >> force;
+		return in;
+	}
 
-		const std::string name;
+	// һϷʱ֮״̬game_controller::snapshot()
+	// ʽmagicversiongame_config֮controller˾˫ʿ͵״̬
+	// ݲɱ䣬game_snapshotֻƹָ롣ͬһշֲϷһݣ
+	// ԻָʱŽԼĳкʿ֮󻥲Ӱ
+	class game_snapshot {
+	private:
+		std::shared_ptr<const std::string> _data;
+	public:
+		constexpr static std::string_view magic = "WCSS";
+		constexpr static int version = 1;
+
+		game_snapshot() = default;
+		// datadata()save()дݣʽǻ汾ʱ׳std::runtime_error
+		explicit game_snapshot(std::string data);
+
+		bool empty() const noexcept { return !_data; }
+		std::string_view data() const noexcept { return _data ? std::string_view(*_data) : std::string_view(); }
+		// дݣ֮game_snapshot(std::string)
+		void save(output_sink& output) const { output << data(); }
+
+		// ձϷ
+		game_config config() const;
+		// game_configʼȡ
+		snapshot_reader body() const;
 	};
 
+	game_snapshot::game_snapshot(std::string data)
+	{
+		snapshot_reader in(data);
+		int head = 0, saved_version = 0;
+		if (data.size() >= magic.size() + 4)
+			in >> head >> saved_version;
+		if (data.compare(0, magic.size(), magic) != 0 or saved_version != version)
+			throw std::runtime_error("Not a snapshot of this version");
+		_data = std::make_shared<const std::string>(std::move(data));
+	}
+
+	game_config game_snapshot::config() const
+	{
+		game_config config;
+		auto in = body();
+		in >> config;
+		return config;
+	}
+
+	snapshot_reader game_snapshot::body() const
+	{
+		if (!_data)
+			throw std::runtime_error("Empty snapshot");
+		return snapshot_reader(data().substr(magic.size() + 4));
+	}
+
 	class city;
 	class warrior;
 	class headquarter;
 
+	using warrior_ptr = pool_ptr<warrior>;
+
+	// Ϸ¼ÿ¼һṹ壬timeΪ¼ʱ
+	struct game_over_event {};
+
+	// campΪռ˾Ӫ
+	struct headquarter_taken_event {
+		int time;
+		camp_label camp;
+	};
+
+	// һսֵ0һս
+	struct fight_ended_event {
+		int time, city_id;
+		int red_health_point, blue_health_point;
+	};
+
+	struct lion_ran_away_event {
+		int time, city_id, id;
+		camp_label camp;
+	};
+
+	// ̬͵¼
+	// ÿ¼ԼĶ߱¼У̶ڴ
+	// publishֻ¼Уdispatchÿʱ̽ʱ¼˳򽻸
+	// ûжߵ¼publishʱֱӶ
+	// ߴ¼ʱӦٷͬ¼
+	template<class... Events>
+	class event_bus {
+	public:
+		constexpr static int max_handler_count = 4;
+		constexpr static int queue_capacity = 64;
+	private:
+		template<class Event>
+		struct channel {
+			struct handler {
+				void* object;
+				void (*call)(void* object, const Event& event);
+			};
+			std::array<handler, max_handler_count> handlers;
+			int handler_count = 0;
+			std::array<Event, queue_capacity> queue;
+			int queued = 0;
+
+			void dispatch()
+			{
+				for (int i = 0; i < queued; ++i)
+					for (int j = 0; j < handler_count; ++j)
+						handlers[j].call(handlers[j].object, queue[i]);
+				queued = 0;
+			}
+		};
+
+		std::tuple<channel<Events>...> _channels;
+	public:
+		// Աһ¼ݴٷ
+		using event_variant = std::variant<Events...>;
+
+		template<class Event>
+		bool has_subscriber() const noexcept { return std::get<channel<Event>>(_channels).handler_count > 0; }
+
+		// Event¼ʱ(object->*handler)(event)
+		template<class Event, auto handler, class T>
+		void subscribe(T* object)
+		{
+			auto& channel = std::get<event_bus::channel<Event>>(_channels);
+			if (channel.handler_count == max_handler_count)
+				throw std::length_error("Too many event handlers!");
+			channel.handlers[channel.handler_count++] = {
+				object, [](void* object, const Event& event) { (static_cast<T*>(object)->*handler)(event); }
+			};
+		}
+
+		template<class Event>
+		void publish(const Event& event)
+		{
+			auto& channel = std::get<event_bus::channel<Event>>(_channels);
+			if (channel.handler_count == 0)
+				return;
+			// ʱȰе¼ȥ
+			if (channel.queued == queue_capacity)
+				channel.dispatch();
+			channel.queue[channel.queued++] = event;
+		}
+
+		// Ѷ¼
+		void dispatch()
+		{
+			std::apply([](auto&... channels) { (channels.dispatch(), ...); }, _channels);
+		}
+	};
+
+	using game_event_bus = event_bus<game_over_event, headquarter_taken_event, fight_ended_event, lion_ran_away_event>;
+
+	// ʿƣӪ  ţջƴӣʱַ
+	struct warrior_name {
+		char data[32];
+		std::size_t size = 0;
+
+		warrior_name(camp_label camp, warrior_kind kind, int id) noexcept
+		{
+			append(camp_name(camp));
+			data[size++] = ' ';
+			append(warrior_type_name(kind));
+			data[size++] = ' ';
+			size = std::to_chars(data + size, std::end(data), id).ptr - data;
+		}
+
+		void append(std::string_view str) noexcept
+		{
+			std::memcpy(data + size, str.data(), str.size());
+			size += str.size();
+		}
+
+		operator std::string_view() const noexcept { return { data, size }; }
+	};
+
+	// Ϸ¼ÿּ¼һṹ壬timeΪʱ
+	// ırecord_formatterӼ¼ɣ¼ʱ¼ͬʱдط־طŵõȫͬı
+	// fields()Ƹʽе˳ȫԱ
+
+	// һϷʼ
+	struct game_started_record {
+		int time, game_index, city_count;
+		auto fields() noexcept { return std::tie(time, game_index, city_count); }
+	};
+
+	// loyaltyֻlion
+	struct warrior_born_record {
+		int time;
+		camp_label camp;
+		warrior_kind kind;
+		int id, loyalty;
+		auto fields() noexcept { return std::tie(time, camp, kind, id, loyalty); }
+	};
+
+	struct lion_ran_away_record {
+		int time;
+		camp_label camp;
+		int id;
+		auto fields() noexcept { return std::tie(time, camp, id); }
+	};
+
+	// city_idǵз˾ʱΪΪǰͨ
+	struct warrior_marched_record {
+		int time;
+		camp_label camp;
+		warrior_kind kind;
+		int id, city_id, health_point, force;
+		auto fields() noexcept { return std::tie(time, camp, kind, id, city_id, health_point, force); }
+	};
+
+	// campΪռ˾Ӫ
+	struct headquarter_taken_record {
+		int time;
+		camp_label camp;
+		auto fields() noexcept { return std::tie(time, camp); }
+	};
+
+	// campӪwolfӵзʿcountweapon
+	struct weapon_snatched_record {
+		int time;
+		camp_label camp;
+		int id, count;
+		weapon_kind weapon;
+		warrior_kind enemy_kind;
+		int enemy_id, city_id;
+		auto fields() noexcept { return std::tie(time, camp, id, count, weapon, enemy_kind, enemy_id, city_id); }
+	};
+
+	// ս˫սֵжʤ
+	struct fight_record {
+		int time, city_id;
+		warrior_kind red_kind;
+		int red_id, red_health_point;
+		warrior_kind blue_kind;
+		int blue_id, blue_health_point;
+		auto fields() noexcept { return std::tie(time, city_id, red_kind, red_id, red_health_point, blue_kind, blue_id, blue_health_point); }
+	};
+
+	struct dragon_yelled_record {
+		int time;
+		camp_label camp;
+		int id, city_id;
+		auto fields() noexcept { return std::tie(time, camp, id, city_id); }
+	};
+
+	struct headquarter_elements_record {
+		int time;
+		camp_label camp;
+		int health_point;
+		auto fields() noexcept { return std::tie(time, camp, health_point); }
+	};
+
+	// weapons[i]Ϊi
+	struct weapon_report_record {
+		int time;
+		camp_label camp;
+		warrior_kind kind;
+		int id;
+		std::array<int, weapon_type_count> weapons;
+		int health_point;
+		auto fields() noexcept { return std::tie(time, camp, kind, id, weapons[0], weapons[1], weapons[2], health_point); }
+	};
+
+	using game_record = std::variant<game_started_record, warrior_born_record, lion_ran_away_record, warrior_marched_record,
+		headquarter_taken_record, weapon_snatched_record, fight_record, dragon_yelled_record,
+		headquarter_elements_record, weapon_report_record>;
+
+	// Ѽ¼ʽΪı
+	class record_formatter {
+	private:
+		output_sink& _out;
+		int _city_count;
+
+		// 0city_count + 1˾
+		void city_name(int city_id) const
+		{
+			if (city_id == 0 or city_id == _city_count + 1)
+				_out << camp_name(city_id == 0 ? camp_label::red : camp_label::blue) << " headquarter";
+			else
+				_out << "city " << city_id;
+		}
+		void warrior(camp_label camp, warrior_kind kind, int id) const { _out << std::string_view(warrior_name(camp, kind, id)); }
+	public:
+		record_formatter(output_sink& out, int city_count) noexcept : _out(out), _city_count(city_count) {}
+
+		void operator()(const game_started_record& record) const
+		{
+			_out << "Case " << record.game_index << ':' << '\n';
+		}
+
+		void operator()(const warrior_born_record& record) const
+		{
+			_out << game_time{ record.time } << ' ';
+			warrior(record.camp, record.kind, record.id);
+			_out << " born" << '\n';
+			if (record.kind == warrior_kind::lion)
+				_out << "Its loyalty is " << record.loyalty << '\n';
+		}
+
+		void operator()(const lion_ran_away_record& record) const
+		{
+			_out << game_time{ record.time } << ' ';
+			warrior(record.camp, warrior_kind::lion, record.id);
+			_out << " ran away" << '\n';
+		}
+
+		void operator()(const warrior_marched_record& record) const
+		{
+			_out << game_time{ record.time } << ' ';
+			warrior(record.camp, record.kind, record.id);
+			_out << std::string_view(record.city_id == 0 or record.city_id == _city_count + 1 ? " reached " : " marched to ");
+			city_name(record.city_id);
+			_out << " with " << record.health_point << " elements and force " << record.force << '\n';
+		}
+
+		void operator()(const headquarter_taken_record& record) const
+		{
+			_out << game_time{ record.time } << ' ';
+			city_name(record.camp == camp_label::red ? 0 : _city_count + 1);
+			_out << " was taken" << '\n';
+		}
+
+		void operator()(const weapon_snatched_record& record) const
+		{
+			_out << game_time{ record.time } << ' ';
+			warrior(record.camp, warrior_kind::wolf, record.id);
+			_out << " took " << record.count << ' ' << weapon_name(record.weapon) << " from ";
+			warrior(enemy_camp(record.camp), record.enemy_kind, record.enemy_id);
+			_out << " in ";
+			city_name(record.city_id);
+			_out << '\n';
+		}
+
+		void operator()(const fight_record& record) const
+		{
+			bool red_alive = record.red_health_point > 0, blue_alive = record.blue_health_point > 0;
+			_out << game_time{ record.time } << ' ';
+			if (red_alive == blue_alive) {
+				_out << "both ";
+				warrior(camp_label::red, record.red_kind, record.red_id);
+				_out << " and ";
+				warrior(camp_label::blue, record.blue_kind, record.blue_id);
+				_out << std::string_view(red_alive ? " were alive in " : " died in ");
+			}
+			else {
+				if (red_alive)
+					warrior(camp_label::red, record.red_kind, record.red_id);
+				else
+					warrior(camp_label::blue, record.blue_kind, record.blue_id);
+				_out << " killed ";
+				if (red_alive)
+					warrior(camp_label::blue, record.blue_kind, record.blue_id);
+				else
+					warrior(camp_label::red, record.red_kind, record.red_id);
+				_out << " in ";
+			}
+			city_name(record.city_id);
+			if (red_alive != blue_alive)
+				_out << " remaining " << (red_alive ? record.red_health_point : record.blue_health_point) << " elements";
+			_out << '\n';
+		}
+
+		void operator()(const dragon_yelled_record& record) const
+		{
+			_out << game_time{ record.time } << ' ';
+			warrior(record.camp, warrior_kind::dragon, record.id);
+			_out << " yelled in ";
+			city_name(record.city_id);
+			_out << '\n';
+		}
+
+		void operator()(const headquarter_elements_record& record) const
+		{
+			_out << game_time{ record.time } << ' ' << record.health_point << " elements in ";
+			city_name(record.camp == camp_label::red ? 0 : _city_count + 1);
+			_out << '\n';
+		}
+
+		void operator()(const weapon_report_record& record) const
+		{
+			_out << game_time{ record.time } << ' ';
+			warrior(record.camp, record.kind, record.id);
+			_out << " has ";
+			for (int index = 0; index < weapon_type_count; ++index)
+				_out << record.weapons[index] << ' ' << weapon_name(static_cast<weapon_kind>(index)) << ' ';
+			_out << "and " << record.health_point << " elements" << '\n';
+		}
+	};
+
+	// Ѽ¼дط־variantеͱţ֮fields()еĸԱ4ֽС
+	void write_record(game_record record, output_sink& out)
+	{
+		char buffer[4 * 16];
+		char* current = buffer;
+		auto put = [&current](int value) {
+			auto bits = static_cast<std::uint32_t>(value);
+			for (int shift = 0; shift < 32; shift += 8)
+				*current++ = static_cast<char>(bits >> shift & 0xff);
+		};
+		put(static_cast<int>(record.index()));
+		std::visit([&put](auto& record) {
+			std::apply([&put](auto&... field) { (put(static_cast<int>(field)), ...); }, record.fields());
+		}, record);
+		out.write(buffer, current - buffer);
+	}
+
+	// ط־Ķȡ־magicͷ֮write_recordдļ¼
+	class replay_reader {
+	private:
+		snapshot_reader _in;
+
+		template<class T>
+		void read_field(T& field);
+	public:
+		constexpr static std::string_view magic = "WCRL";
+
+		// magicͷʱ׳std::runtime_error
+		explicit replay_reader(std::string_view data);
+
+		// ȡһ¼־ʱfalseݲʱ׳std::runtime_error
+		bool next(game_record& record);
+	};
+
+	replay_reader::replay_reader(std::string_view data)
+		: _in(data.substr(std::min(data.size(), magic.size())))
+	{
+		if (data.substr(0, magic.size()) != magic)
+			throw std::runtime_error("Not a replay log");
+	}
+
+	template<class T>
+	void replay_reader::read_field(T& field)
+	{
+		int value;
+		_in >> value;
+		if constexpr (std::is_enum_v<T>) {
+			constexpr int limit = std::is_same_v<T, camp_label> ? camp_count
+				: std::is_same_v<T, warrior_kind> ? warrior_type_count : weapon_type_count;
+			if (value < 0 or value >= limit)
+				throw std::runtime_error("Corrupted replay log");
+		}
+		field = static_cast<T>(value);
+	}
+
+	// ͱΪindexĿռ¼
+	template<std::size_t Index = 0>
+	game_record make_record(int index)
+	{
+		if constexpr (Index < std::variant_size_v<game_record>) {
+			if (index == static_cast<int>(Index))
+				return game_record(std::in_place_index<Index>);
+			return make_record<Index + 1>(index);
+		}
+		else
+			throw std::runtime_error("Corrupted replay log");
+	}
+
+	bool replay_reader::next(game_record& record)
+	{
+		if (_in.empty())
+			return false;
+		int index;
+		_in >> index;
+		record = make_record(index);
+		std::visit([this](auto& record) {
+			std::apply([this](auto&... field) { (read_field(field), ...); }, record.fields());
+		}, record);
+		return true;
+	}
+
+	// ӻط־ؽıֻlast_timeļ¼ģ
+	// ־ֻ¼ûϷ״̬ܴлָĳһʱ̵ϷУ
+	// Ҫ;ʱgame_snapshot(--checkpoint)
+	void replay(std::string_view log, output_sink& output, int last_time = std::numeric_limits<int>::max())
+	{
+		replay_reader reader(log);
+		game_record record;
+		int city_count = 0;
+		while (reader.next(record)) {
+			if (auto started = std::get_if<game_started_record>(&record))
+				city_count = started->city_count;
+			if (std::visit([](const auto& record) { return record.time; }, record) <= last_time)
+				std::visit(record_formatter(output, city_count), record);
+		}
+	}
+
+	// value͵1ڵλvalueΪ0
+	inline int lowest_bit(std::uint64_t value) noexcept
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, value);
+		return index;
+#else
+		return __builtin_ctzll(value);
+#endif
+	}
+
+	// һӪʿڳųһ
+	// ʿڻУڳб = (λ + direction * offset) mod 
+	// ȫǰһֻıoffsetʿĲλ(slot)ӳ
+	class game_controller;
+
+	class marching_column {
+	private:
+		std::vector<warrior_ptr> _slots;
+		// ÿʿһλͼÿλһλλиʿʱһΪ1
+		// ʿ뿪λʿnext_occupied
+		std::array<std::vector<std::uint64_t>, warrior_type_count> _occupied;
+		int _offset = 0;
+		// ǰ򣺺췽1()-1(żС)
+		int _direction;
+
+		int wrap(int index) const noexcept
+		{
+			int size = _slots.size();
+			return (index % size + size) % size;
+		}
+	public:
+		// city_count˾
+		marching_column(int city_count, int direction)
+			: _slots(city_count), _direction(direction)
+		{
+			for (auto& bits : _occupied)
+				bits.resize((city_count + 63) / 64);
+		}
+
+		int slot_of(int city_index) const noexcept { return wrap(city_index - _direction * _offset); }
+		int city_of(int slot) const noexcept { return wrap(slot + _direction * _offset); }
+		warrior_ptr& at_city(int city_index) noexcept { return _slots[slot_of(city_index)]; }
+		const warrior_ptr& at_city(int city_index) const noexcept { return _slots[slot_of(city_index)]; }
+
+		// ɵʿΪcity_indexĳ
+		void place(int city_index, warrior_ptr warrior) noexcept;
+		// ȫǰһԽյʿƻ㣬
+		void advance() noexcept;
+		// [first, last]СkindsĳֱʿСбţûʱlast + 1
+		int next_occupied(int first, int last, unsigned kinds = all_warrior_kinds) noexcept;
+
+		// գƫƺȫʿʱλ뱾Ӫcampʿ
+		void save(snapshot_writer& out) const;
+		void load(game_controller* controller, camp_label camp, snapshot_reader& in);
+	};
+
+	class thread_pool;
+	class fight_cache;
+
+	// н׶һеɾʿ¼׶ν󰴳б˳ϲ
+	struct city_phase_buffer {
+		memory_sink output;
+		std::vector<warrior_ptr> warrior_to_clean;
+		std::vector<game_event_bus::event_variant> events;
+		memory_sink recording;
+	};
+
 	class game_controller {
 	private:
-		// ģʽ
-		inline static game_controller* _the_controller;
+		// ǰ߳ڴĲн׶εĻڲн׶ʱΪnullptr
+		inline static thread_local city_phase_buffer* _phase_buffer = nullptr;
+
+		game_scheduler _scheduler;
+		game_event_bus _events;
+		// Ϸ¼λ
+		output_sink& _output;
+		// ط־λãΪnullptrʱ¼
+		output_sink* _recording = nullptr;
+
+		// Ϸڴ棺ʿռ_poolãcontrollerʱ_arenaͷ
+		// _citys֮ǰ֤
+		std::pmr::monotonic_buffer_resource _arena;
+		std::pmr::unsynchronized_pool_resource _pool{ &_arena };
+		// ʿʱÿСʱһͷſռ
+		std::vector<warrior_ptr> _warrior_to_clean;
+		// ֽ׶βʹõ̳߳أΪnullptrʱд
+		thread_pool* _phase_pool = nullptr;
+		// սĻ棬Ϊnullptrʱʹ
+		fight_cache* _fight_cache = nullptr;
+		// н׶Ҫĳбź͸Ļʱظʹ
+		std::vector<int> _phase_cities;
+		std::vector<city_phase_buffer> _phase_buffers;
 
 		// front()Ǻħ˾ back()ħ˾ 
 		// _city[i]ǱΪiĳ
 		std::vector<std::unique_ptr<city>> _citys;
+		// ˫ʿ±Ϊcamp_num
+		std::array<marching_column, camp_count> _columns;
 
 		bool _game_over = false;
+		fight_engine _fight_engine = fight_engine::soa;
 	public:
+		const int base_HP;
 		const int lion_loyalty_reduce;
 		const int end_time;
 		const std::array<int, warrior_type_count> warrior_HP, warrior_force;
 
 		game_controller(int base_HP, int city_count, int loyalty_reduce, int end_time,
-			const std::array<int, warrior_type_count>& warrior_HP, const std::array<int, warrior_type_count>& warrior_force);
-		~game_controller();
+			const std::array<int, warrior_type_count>& warrior_HP, const std::array<int, warrior_type_count>& warrior_force,
+			output_sink& output = standard_output());
+		game_controller(const game_config& config, output_sink& output = standard_output());
+		// ӿջָ֮run
+		// configָʹõĲʱͬͬ
+		game_controller(const game_snapshot& snapshot, output_sink& output = standard_output());
+		game_controller(const game_snapshot& snapshot, const game_config& config, output_sink& output = standard_output());
+		// кʿָcontrollerָ
+		game_controller(const game_controller&) = delete;
+		game_controller& operator=(const game_controller&) = delete;
+
+		// ʿĳʱн׶Ҳд
+		constexpr static int parallel_phase_threshold = 256;
+
+		output_sink& output() noexcept { return _phase_buffer ? _phase_buffer->output : _output; }
+		// ѻط־дrecordingΪnullptrʱ¼
+		void set_recording(output_sink* recording) noexcept { _recording = recording; }
+		// һϷ¼¼ʱͬʱдط־
+		template<class Record>
+		void emit(const Record& record)
+		{
+			record_formatter(output(), static_cast<int>(_citys.size()) - 2)(record);
+			if (_recording)
+				write_record(record, _phase_buffer ? _phase_buffer->recording : *_recording);
+		}
+		// Ϸʿڴ
+		std::pmr::memory_resource* memory() noexcept { return &_pool; }
 
-		// ȡǰȫcontroller
-		static game_controller& get_controller() { return *_the_controller; }
+		fight_engine engine() const noexcept { return _fight_engine; }
+		void set_fight_engine(fight_engine engine) noexcept { _fight_engine = engine; }
+		// ÿСʱ35()͵40(ս)лӰ죬poolϲд
+		void set_phase_pool(thread_pool* pool) noexcept { _phase_pool = pool; }
+		// սǰcacheвҽΪnullptrʱʹû
+		void set_fight_cache(fight_cache* cache) noexcept { _fight_cache = cache; }
+		fight_cache* shared_fight_cache() const noexcept { return _fight_cache; }
 
 		headquarter& get_headquarter(camp_label camp);
-
-		void send_message(game_message msg, std::any param = {});
+		// ˾ڵĳб
+		int headquarter_city(camp_label camp) const noexcept { return camp == camp_label::red ? 0 : static_cast<int>(_citys.size()) - 1; }
+		city& city_at(int index) noexcept { return *_citys[index]; }
+		marching_column& column(camp_label camp) noexcept { return _columns[camp_num(camp)]; }
+		// ܵʿɾ
+		void clean_later(warrior_ptr warrior)
+		{
+			(_phase_buffer ? _phase_buffer->warrior_to_clean : _warrior_to_clean).push_back(std::move(warrior));
+		}
+		// ǼĳÿСʱminuteҪյʱ
+		void subscribe(int minute) { _scheduler.subscribe(minute); }
+		void subscribe_minutes(std::uint64_t minutes) { _scheduler.subscribe_minutes(minutes); }
+
+		// Ϸе¼ÿʱ̽ʱַ
+		game_event_bus& events() noexcept { return _events; }
+		template<class Event>
+		void publish(const Event& event)
+		{
+			if (!_events.has_subscriber<Event>())
+				return;
+			if (_phase_buffer)
+				_phase_buffer->events.emplace_back(event);
+			else
+				_events.publish(event);
+		}
+		void on_game_over([[maybe_unused]] const game_over_event& event) noexcept { _game_over = true; }
+		bool game_over() const noexcept { return _game_over; }
+		// ˫Ƿkindʿ˾е
+		bool has_warrior(warrior_kind kind) noexcept;
 		void on_update_time(int new_time);
 
 		// ʿǰ
 		void warrior_move_forward(int time);
 
-		// Ϸ
-		void run();
+		// ȫ״ֻ̬ʱ֮ãrun_untilغ
+		game_snapshot snapshot() const;
+
+		// Ϸе
+		void run() { run_until(end_time); }
+		// last_timeʱ̣֮Լ
+		void run_until(int last_time);
+	private:
+		// ˳kindsĳʿͨеf(index)
+		template<class F>
+		void for_each_occupied_city(unsigned kinds, F&& f);
+		// дkindsĳʿͨУȰб˳ϲ
+		void update_cities_parallel(int time, unsigned kinds);
 	};
 
 	class city : public game_object {
 	protected:
+		game_controller* _controller;
 		int _city_id;
-
-		std::array<std::unique_ptr<warrior>, camp_count> _warriors;
-		// ʿʱÿСʱһͷſռ
-		std::vector<std::unique_ptr<warrior>> _warrior_to_clean;
 	public:
-		city(int id) noexcept;
-		city(int id, const std::string& name) noexcept;
+		city(game_controller* controller, int id) noexcept;
 		virtual ~city() = default;
 
+		int city_id() const noexcept { return _city_id; }
 		// ȡĳһӪʿ
-		std::unique_ptr<warrior>& warrior_of(camp_label camp) noexcept { return _warriors[camp_num(camp)]; }
-		const std::unique_ptr<warrior>& warrior_of(camp_label camp) const noexcept { return _warriors[camp_num(camp)]; }
+		warrior_ptr& warrior_of(camp_label camp) noexcept { return _controller->column(camp).at_city(_city_id); }
+		const warrior_ptr& warrior_of(camp_label camp) const noexcept { return _controller->column(camp).at_city(_city_id); }
 
 		// ʿɾ
 		void remove_warrior(camp_label camp);
@@ -177,6 +1641,12 @@ namespace warcraft
 		void fight(int time) noexcept;
 
 		virtual void on_update_time(int new_time) override;
+	protected:
+		// غϽսֱһ˫޷˺
+		void fight_classic(camp_label attacker_camp) noexcept;
+		void fight_soa(camp_label attacker_camp) noexcept;
+		// սͽɻ
+		void report_fight(int time) noexcept;
 	};
 
 	class headquarter : public city {
@@ -191,7 +1661,7 @@ namespace warcraft
 		// ǷѾֹͣʿ
 		bool _stopped = false;
 	public:
-		headquarter(camp_label camp, int health_point, int id) noexcept;
+		headquarter(game_controller* controller, camp_label camp, int health_point, int id) noexcept;
 		virtual ~headquarter() = default;
 
 		bool isoccupied() const noexcept { return warrior_of(enemy_camp(_camp)).operator bool(); }
@@ -199,56 +1669,196 @@ namespace warcraft
 		virtual void on_warrior_march_to(int time) noexcept override;
 		void show_health_point(int time) const noexcept;
 
+		// գԪʿɵĽ
+		void save(snapshot_writer& out) const;
+		void load(snapshot_reader& in);
+
 		virtual void on_update_time(int new_time) override;
 	protected:
 		void generate_warrior(int time);
 	};
 
-	class weapon : public game_object {
+	// ̶ԪֱӴڶڵ飬ڴ
+	// ֻ֧ĩβգTҪĬϹ
+	template<class T, std::size_t N>
+	class static_vector {
+	private:
+		std::array<T, N> _data;
+		std::size_t _size = 0;
+	public:
+		using value_type = T;
+		using iterator = T*;
+		using const_iterator = const T*;
+
+		constexpr static std::size_t capacity() noexcept { return N; }
+		std::size_t size() const noexcept { return _size; }
+		bool empty() const noexcept { return _size == 0; }
+		void clear() noexcept { _size = 0; }
+
+		// ǵߵĴ
+		void push_back(const T& value) noexcept { _data[_size++] = value; }
+		template<class... Args>
+		T& emplace_back(Args&&... args) noexcept { return _data[_size++] = T(std::forward<Args>(args)...); }
+
+		T& operator[](std::size_t index) noexcept { return _data[index]; }
+		const T& operator[](std::size_t index) const noexcept { return _data[index]; }
+		iterator begin() noexcept { return _data.data(); }
+		iterator end() noexcept { return _data.data() + _size; }
+		const_iterator begin() const noexcept { return _data.data(); }
+		const_iterator end() const noexcept { return _data.data() + _size; }
+	};
+
+	// սʹõһweapon_inventoryʹ˳չõ
+	class weapon {
+	public:
+		weapon_kind kind = weapon_kind::sword;
 	protected:
-		int _durability, _force = 0;
+		int _durability = 0, _force = 0;
 	public:
-		weapon(const std::string& name, int index, int durability);
-		virtual ~weapon() = 0;
+		weapon() noexcept = default;
+		weapon(weapon_kind kind, int durability) noexcept : kind(kind), _durability(durability) {}
 
-		const int weapon_index;
-		
 		int durability() const noexcept { return _durability; }
 		int force() const noexcept { return _force; }
 		// return: ܷʹ
-		virtual bool reduce_durability() noexcept { return --_durability > 0; }
+		bool reduce_durability() noexcept { return initial_durability(kind) < 0 or --_durability > 0; }
 		// ʿĹ
-		virtual int set_force(int holder_force) noexcept = 0;
+		int set_force(int holder_force) noexcept { return _force = weapon_force(kind, holder_force); }
 	};
 
-	class sword : public weapon {
-	public:
-		// sword;-1ʾ;
-		sword() : weapon("sword", 0, -1) {}
-		virtual ~sword() = default;
+	// ÿռõͰ;õֻһͰÿ;ֵһͰ
+	constexpr int weapon_bucket_size(weapon_kind kind) noexcept
+	{
+		return std::max(initial_durability(kind), 1);
+	}
 
-		virtual bool reduce_durability() noexcept override { return true; }
-		virtual int set_force(int holder_force) noexcept override { return _force = holder_force * 2 / 10; }
-	};
+	// һͰı
+	constexpr int weapon_bucket_base(weapon_kind kind) noexcept
+	{
+		int base = 0;
+		for (int index = 0; index < static_cast<int>(kind); ++index)
+			base += weapon_bucket_size(static_cast<weapon_kind>(index));
+		return base;
+	}
 
-	class bomb : public weapon {
-	public:
-		bomb() noexcept : weapon("bomb", 1, 1) {}
-		virtual ~bomb() = default;
+	constexpr int weapon_bucket_count = weapon_bucket_base(weapon_kind::arrow) + weapon_bucket_size(weapon_kind::arrow);
 
-		virtual int set_force(int holder_force) noexcept override { return _force = holder_force * 4 / 10; }
-	};
+	// ʿ
+	// ͬͬ;õȫȼֻۣ(, ;)Ͱ¼
+	// Ͱͬ;õУʹ˳ͽɻ˳;õݼ
+	// ˳ֱӰͰõҪ
+	class weapon_inventory {
+	private:
+		std::array<int8_t, weapon_bucket_count> _count{ 0 };
+		int _size = 0;
 
-	class arrow : public weapon {
+		static int bucket(weapon_kind kind, int durability) noexcept
+		{
+			return weapon_bucket_base(kind) + (durability < 0 ? 0 : durability - 1);
+		}
 	public:
-		arrow() noexcept : weapon("arrow", 2, 2) {}
-		virtual ~arrow() = default;
+		int size() const noexcept { return _size; }
+		bool empty() const noexcept { return _size == 0; }
+		void clear() noexcept { _count.fill(0); _size = 0; }
+
+		// ĳ
+		int count(weapon_kind kind) const noexcept
+		{
+			int base = weapon_bucket_base(kind), result = 0;
+			for (int index = 0; index < weapon_bucket_size(kind); ++index)
+				result += _count[base + index];
+			return result;
+		}
 
-		virtual int set_force(int holder_force) noexcept override { return _force = holder_force * 3 / 10; }
+		// һ;Ϊ0Ѿֱ꣬Ӷ
+		void add(weapon_kind kind, int durability, int num = 1) noexcept
+		{
+			if (durability == 0)
+				return;
+			_count[bucket(kind, durability)] += num;
+			_size += num;
+		}
+		// һ
+		void add(weapon_kind kind) noexcept { add(kind, initial_durability(kind)); }
+
+		// ͰѹһÿͰ8λڿ
+		std::uint32_t pack() const noexcept
+		{
+			static_assert(weapon_bucket_count <= 4);
+			std::uint32_t result = 0;
+			for (int index = 0; index < weapon_bucket_count; ++index)
+				result |= static_cast<std::uint32_t>(static_cast<uint8_t>(_count[index])) << index * 8;
+			return result;
+		}
+		void unpack(std::uint32_t packed) noexcept
+		{
+			_size = 0;
+			for (int index = 0; index < weapon_bucket_count; ++index) {
+				_count[index] = static_cast<int8_t>(packed >> index * 8 & 0xff);
+				_size += _count[index];
+			}
+		}
+
+		// ʹ˳εf(kind, durability)
+		template<class F>
+		void for_each(F&& f) const
+		{
+			for (int index = 0; index < weapon_type_count; ++index) {
+				auto kind = static_cast<weapon_kind>(index);
+				int base = weapon_bucket_base(kind);
+				for (int offset = 0; offset < weapon_bucket_size(kind); ++offset)
+					for (int num = 0; num < _count[base + offset]; ++num)
+						f(kind, initial_durability(kind) < 0 ? -1 : offset + 1);
+			}
+		}
+
+		// ʹ˳չдoutstd::back_inserter(static_vector)
+		template<class OutputIt>
+		OutputIt expand(OutputIt out) const
+		{
+			for_each([&out](weapon_kind kind, int durability) { *out++ = weapon(kind, durability); });
+			return out;
+		}
+		// չؽ棬ٷŻ
+		template<class InputIt>
+		void assign(InputIt first, InputIt last) noexcept
+		{
+			clear();
+			for (; first != last; ++first)
+				add(first->kind, first->durability());
+		}
+
+		// С𣬿治Ϊ
+		weapon_kind first_kind() const noexcept
+		{
+			int index = 0;
+			while (count(static_cast<weapon_kind>(index)) == 0)
+				++index;
+			return static_cast<weapon_kind>(index);
+		}
+
+		// ˳𲻳lasttomax_num
+		// return: ƶ
+		int move_to(weapon_inventory& to, int max_num, weapon_kind last = weapon_kind::arrow) noexcept
+		{
+			int moved = 0;
+			for (int index = 0; index <= static_cast<int>(last); ++index) {
+				auto kind = static_cast<weapon_kind>(index);
+				int base = weapon_bucket_base(kind);
+				for (int offset = weapon_bucket_size(kind) - 1; offset >= 0; --offset) {
+					int num = std::min<int>(_count[base + offset], max_num - moved);
+					_count[base + offset] -= num;
+					to._count[base + offset] += num;
+					moved += num;
+				}
+			}
+			_size -= moved;
+			to._size += moved;
+			return moved;
+		}
 	};
 
 	class warrior : public game_object {
-		friend class game_controller; // ĳ
 		friend class wolf; // 
 		friend class city; // ս
 	protected:
@@ -256,63 +1866,138 @@ namespace warcraft
 		int _health_point, _force;
 		int _id;
 
-		std::vector<std::unique_ptr<weapon>> _weapons;
+		weapon_inventory _weapons;
 
-		city* _city;
+		game_controller* _controller;
+		// ڱӪmarching_columnеλ
+		int _slot;
 	public:
-		warrior(camp_label camp, int health_point, int force, int id, const std::string& type_name, int weapon_num = 0) noexcept;
+		warrior(game_controller* controller, camp_label camp, int health_point, int force, int id, warrior_kind kind, int weapon_num = 0) noexcept;
 		virtual ~warrior() = 0;
 
-		const std::string type_name;
+		const warrior_kind kind;
 		constexpr static int max_weapon_count = 10;
 		camp_label camp() const noexcept { return _camp; }
 		int health_point() const noexcept { return _health_point; }
 		int force() const noexcept { return _force; }
 		int id() const noexcept { return _id; }
+		// Ҫʱƴڶ
+		warrior_name name() const noexcept { return { _camp, kind, _id }; }
 		int weapon_count() const noexcept { return _weapons.size(); }
-		weapon& weapon_at(int index) noexcept { return *_weapons[index]; }
+		int slot() const noexcept { return _slot; }
 
+		// ڵĳУɲλ
+		city& current_city() const noexcept { return _controller->city_at(_controller->column(_camp).city_of(_slot)); }
 		// ԼͬһڵĵзʿֻԼnullptr
-		warrior* enemy_now() const noexcept { return _city->warrior_of(enemy_camp(_camp)).get(); }
+		warrior* enemy_now() const noexcept { return current_city().warrior_of(enemy_camp(_camp)).get(); }
 
-		virtual void show_additional_information() const noexcept {}
 		virtual void on_move_forward() noexcept {}
-		virtual void show_weapon(int time) noexcept;
-		// սǰ׼
-		virtual void prefight() noexcept;
-		// ս
-		virtual void postfight() noexcept;
-		// սнн
-		virtual void on_attacking(weapon& weapon, warrior& aim) noexcept;
+		void show_weapon(int time) noexcept;
+		// սннʿĲֻhurt_by_own_bomb(kind)УҪ麯
+		void on_attacking(weapon& weapon, warrior& aim) noexcept;
 		// սб
-		virtual void on_attacked(weapon& weapon, warrior& attacker) noexcept;
+		void on_attacked(weapon& weapon, warrior& attacker) noexcept;
 		// ս
 		virtual void on_alive(int time) noexcept {};
 
+		// գͱ״̬ں׷Լ
+		virtual void save(snapshot_writer& out) const;
+		virtual void load(snapshot_reader& in);
+
 		virtual void on_update_time(int new_time) override;
 	};
 
+	// һս˫ݣṹ(SoA)ţһά±ΪӪ
+	// սֻдЩʿ
+	struct fight_state {
+		std::array<int, camp_count> health_point, weapon_count, next_weapon;
+		std::array<bool, camp_count> hurt_by_own_bomb, has_forceful_weapon, stopped;
+		std::array<std::array<weapon_kind, warrior::max_weapon_count>, camp_count> kind;
+		std::array<std::array<int, warrior::max_weapon_count>, camp_count> durability, weapon_force;
+
+		// attackerӪʼ湥city::fight_classicȫͬ
+		void resolve(int attacker) noexcept;
+	private:
+		// ˫ֻʣswordʱÿι˺̶սڽ׶Σֱ
+		// return: Ƿó˽˫ֹͣȴ޷˺ʱֻغģ
+		bool resolve_periodic(int attacker) noexcept;
+	};
+
+	// սĽֻЩȹӪ˫ֵʹbombʱǷ˺
+	// ʿıźڵĳ޹أ±ΪӪ
+	struct fight_key {
+		std::array<int, camp_count> health_point, force;
+		std::array<std::uint32_t, camp_count> weapons;
+		std::array<bool, camp_count> hurt_by_own_bomb;
+		int attacker;
+
+		bool operator==(const fight_key& other) const noexcept
+		{
+			return std::tie(health_point, force, weapons, hurt_by_own_bomb, attacker)
+				== std::tie(other.health_point, other.force, other.weapons, other.hurt_by_own_bomb, other.attacker);
+		}
+	};
+
+	// ս˫ֵ棬weapon_inventory::pack()Ľ
+	struct fight_result {
+		std::array<int, camp_count> health_point;
+		std::array<std::uint32_t, camp_count> weapons;
+	};
+
+	// ¼սĻ棬̶ԺCLOCK㷨̭
+	// ÿһλʱ1̭ʱָѭɨ裬λΪ1̭һΪ0
+	// Ա߳еĶϷãв
+	class fight_cache {
+	private:
+		struct entry {
+			fight_key key;
+			fight_result result;
+			bool referenced;
+		};
+		struct key_hash {
+			std::size_t operator()(const fight_key& key) const noexcept;
+		};
+
+		std::vector<entry> _entries;
+		// _entries±
+		std::unordered_map<fight_key, int, key_hash> _index;
+		std::size_t _capacity;
+		// CLOCKָ룬һǷ̭
+		std::size_t _hand = 0;
+		mutable std::mutex _mutex;
+		std::uint64_t _hits = 0, _misses = 0, _evictions = 0;
+	public:
+		explicit fight_cache(std::size_t capacity);
+
+		// ʱѽдresult
+		bool find(const fight_key& key, fight_result& result);
+		void insert(const fight_key& key, const fight_result& result);
+		// дδдʺ̭
+		void report(std::ostream& out) const;
+	};
+
 	class dragon : public warrior {
 	private:
 		double _morale;
 	public:
-		dragon(camp_label camp, int health_point, int force, int id, double morale) noexcept;
+		dragon(game_controller* controller, camp_label camp, int health_point, int force, int id, double morale) noexcept;
 		virtual ~dragon() = default;
 
 		virtual void on_alive(int time) noexcept override;
+
+		virtual void save(snapshot_writer& out) const override;
+		virtual void load(snapshot_reader& in) override;
 	};
 
 	class ninja : public warrior {
 	public:
-		ninja(camp_label camp, int health_point, int force, int id) noexcept;
+		ninja(game_controller* controller, camp_label camp, int health_point, int force, int id) noexcept;
 		virtual ~ninja() = default;
-
-		virtual void on_attacking(weapon& weapon, warrior& aim) noexcept override;
 	};
 
 	class iceman : public warrior {
 	public:
-		iceman(camp_label camp, int health_point, int force, int id) noexcept;
+		iceman(game_controller* controller, camp_label camp, int health_point, int force, int id) noexcept;
 		virtual ~iceman() = default;
 
 		virtual void on_move_forward() noexcept override { _health_point -= _health_point / 10; }
@@ -322,19 +2007,21 @@ namespace warcraft
 	private:
 		int _loyalty;
 	public:
-		lion(camp_label camp, int health_point, int force, int id, int loyalty) noexcept;
+		lion(game_controller* controller, camp_label camp, int health_point, int force, int id, int loyalty) noexcept;
 		virtual ~lion() = default;
 
-		virtual void show_additional_information() const noexcept override;
-		virtual void on_move_forward() noexcept override { _loyalty -= game_controller::get_controller().lion_loyalty_reduce; }
+		virtual void on_move_forward() noexcept override { _loyalty -= _controller->lion_loyalty_reduce; }
 		void try_runaway(int new_time) noexcept;
 
+		virtual void save(snapshot_writer& out) const override;
+		virtual void load(snapshot_reader& in) override;
+
 		virtual void on_update_time(int new_time) override;
 	};
 
 	class wolf : public warrior {
 	public:
-		wolf(camp_label camp, int health_point, int force, int id) noexcept;
+		wolf(game_controller* controller, camp_label camp, int health_point, int force, int id) noexcept;
 		virtual ~wolf() = default;
 
 		void snatch(int time) noexcept;
@@ -344,6 +2031,52 @@ namespace warcraft
 
 	game_object::~game_object() = default;
 
+	void game_scheduler::subscribe(int minute)
+	{
+		if (_subscribed >> minute & 1)
+			return;
+		_subscribed |= std::uint64_t(1) << minute;
+		int time = hour(_now) * 60 + minute;
+		if (time <= _now)
+			time += 60;
+		_events.push(time);
+	}
+
+	void game_scheduler::subscribe_minutes(std::uint64_t minutes)
+	{
+		for (minutes &= ~_subscribed; minutes; minutes &= minutes - 1)
+			subscribe(lowest_bit(minutes));
+	}
+
+	int game_scheduler::pop()
+	{
+		_now = _events.top();
+		_events.pop();
+		_events.push(_now + 60);
+		return _now;
+	}
+
+	void game_scheduler::save(snapshot_writer& out) const
+	{
+		auto events = _events;
+		out << _now << static_cast<int>(_subscribed & 0xffffffff) << static_cast<int>(_subscribed >> 32)
+			<< static_cast<int>(events.size());
+		for (; !events.empty(); events.pop())
+			out << events.top();
+	}
+
+	void game_scheduler::load(snapshot_reader& in)
+	{
+		int low, high, count;
+		in >> _now >> low >> high >> count;
+		_subscribed = static_cast<std::uint32_t>(low) | static_cast<std::uint64_t>(static_cast<std::uint32_t>(high)) << 32;
+		_events = {};
+		for (int time; count > 0; --count) {
+			in >> time;
+			_events.push(time);
+		}
+	}
+
 	void headquarter::on_update_time(int new_time)
 	{
 		switch (minute(new_time)) {
@@ -357,34 +2090,63 @@ namespace warcraft
 		city::on_update_time(new_time);
 	}
 
-	headquarter::headquarter(camp_label camp, int health_point, int id) noexcept
+	headquarter::headquarter(game_controller* controller, camp_label camp, int health_point, int id) noexcept
 		: _camp(camp), _health_point(health_point),
-		city(id, camp_name(camp) + " headquarter")
-	{}
+		city(controller, id)
+	{
+		controller->subscribe(0);
+		controller->subscribe(50);
+	}
 
-	std::unique_ptr<warrior> make_warrior(int index, camp_label camp, int health_point, int force, int id, int left_hp)
+	warrior_ptr make_warrior(game_controller* controller, warrior_kind kind, camp_label camp, int health_point, int force, int id, int left_hp)
 	{
-		switch (index) {
-		case 0:
-			return std::make_unique<dragon>(camp, health_point, force, id, static_cast<double>(left_hp) / health_point);
-		case 1:
-			return std::make_unique<ninja>(camp, health_point, force, id);
-		case 2:
-			return std::make_unique<iceman>(camp, health_point, force, id);
-		case 3:
-			return std::make_unique<lion>(camp, health_point, force, id, left_hp);
-		case 4:
-			return std::make_unique<wolf>(camp, health_point, force, id);
+		auto memory = controller->memory();
+		switch (kind) {
+		case warrior_kind::dragon:
+			return make_pooled<dragon>(memory, controller, camp, health_point, force, id, static_cast<double>(left_hp) / health_point);
+		case warrior_kind::ninja:
+			return make_pooled<ninja>(memory, controller, camp, health_point, force, id);
+		case warrior_kind::iceman:
+			return make_pooled<iceman>(memory, controller, camp, health_point, force, id);
+		case warrior_kind::lion:
+			return make_pooled<lion>(memory, controller, camp, health_point, force, id, left_hp);
+		case warrior_kind::wolf:
+			return make_pooled<wolf>(memory, controller, camp, health_point, force, id);
 		default:
 			return nullptr;
 		}
 	}
 
+	// ӿжһʿͱǰ״̬warrior::loadȡ
+	warrior_ptr load_warrior(game_controller* controller, camp_label camp, snapshot_reader& in)
+	{
+		int kind, id;
+		in >> kind >> id;
+		if (kind < 0 or kind >= warrior_type_count)
+			throw std::runtime_error("Corrupted snapshot");
+		auto warrior = make_warrior(controller, static_cast<warrior_kind>(kind), camp, 1, 0, id, 0);
+		warrior->load(in);
+		return warrior;
+	}
+
+	void headquarter::save(snapshot_writer& out) const
+	{
+		out << _health_point << _last_generate_warrior << _generated_count << static_cast<int>(_stopped);
+	}
+
+	void headquarter::load(snapshot_reader& in)
+	{
+		int stopped;
+		in >> _health_point >> _last_generate_warrior >> _generated_count >> stopped;
+		_stopped = stopped != 0;
+	}
+
 	void headquarter::generate_warrior(int time)
 	{
 		if (_stopped) return;
 
-		auto& controller = game_controller::get_controller();
+		profile_timer timer(profile_phase::generate);
+		auto& controller = *_controller;
 		// ̶˳
 		static constexpr int generate_order[camp_count][5]
 			= { { 2, 3, 4, 1, 0 }, { 3, 0, 1, 2, 4 } };
@@ -397,55 +2159,89 @@ namespace warcraft
 		int index = order[_last_generate_warrior];
 		int id = ++_generated_count, hp = controller.warrior_HP[index], force = controller.warrior_force[index];
 		_health_point -= hp;
-		warrior_of(_camp) = make_warrior(index, _camp, hp, force, id, _health_point);
-		std::cout << time_to_str(time) << ' '
-			<< warrior_of(_camp)->name << " born" << std::endl;
-		warrior_of(_camp)->show_additional_information();
+		auto kind = static_cast<warrior_kind>(index);
+		controller.column(_camp).place(_city_id, make_warrior(_controller, kind, _camp, hp, force, id, _health_point));
+		controller.emit(warrior_born_record{ time, _camp, kind, id, kind == warrior_kind::lion ? _health_point : 0 });
+		profile_count(profile_counter::warriors_born);
 	}
 
 	void headquarter::on_warrior_march_to(int time) noexcept
 	{
 		if (auto& warrior = warrior_of(enemy_camp(_camp)); warrior) {
 			warrior->on_move_forward();
-			std::cout << time_to_str(time) << ' '
-				<< warrior->name << " reached "
-				<< name << " with "
-				<< warrior->health_point() << " elements and force "
-				<< warrior->force() << std::endl;
-			std::cout << time_to_str(time) << ' '
-				<< name << " was taken" << std::endl;
+			_controller->emit(warrior_marched_record{ time, warrior->camp(), warrior->kind, warrior->id(),
+				_city_id, warrior->health_point(), warrior->force() });
+			_controller->emit(headquarter_taken_record{ time, _camp });
+			_controller->publish(headquarter_taken_event{ time, _camp });
 		}
 	}
 
 	void headquarter::show_health_point(int time) const noexcept
 	{
-		std::cout << time_to_str(time) << ' '
-			<< _health_point << " elements in "
-			<< name << std::endl;
+		_controller->emit(headquarter_elements_record{ time, _camp, _health_point });
 	}
 
 	game_controller::game_controller(int base_HP, int city_count, int loyalty_reduce, int end_time,
-		const std::array<int, warrior_type_count>& warrior_HP, const std::array<int, warrior_type_count>& warrior_force)
-		: warrior_HP(warrior_HP),
-		warrior_force(warrior_force),
+		const std::array<int, warrior_type_count>& warrior_HP, const std::array<int, warrior_type_count>& warrior_force,
+		output_sink& output)
+		: _output(output),
 		_citys(city_count + 2),
+		_columns{ { marching_column(city_count + 2, 1), marching_column(city_count + 2, -1) } },
+		base_HP(base_HP),
 		lion_loyalty_reduce(loyalty_reduce),
-		end_time(end_time)
-	{
-		// ģʽ
-		if (_the_controller)
-			throw std::runtime_error("One controller has been existing!");
-		_the_controller = this;
-		_citys.front() = std::make_unique<headquarter>(camp_label::red, base_HP, 0);
-		_citys.back() = std::make_unique<headquarter>(camp_label::blue, base_HP, city_count + 1);
+		end_time(end_time),
+		warrior_HP(warrior_HP),
+		warrior_force(warrior_force)
+	{
+		subscribe(10);
+		subscribe(59);
+		_events.subscribe<game_over_event, &game_controller::on_game_over>(this);
+		_citys.front() = std::make_unique<headquarter>(this, camp_label::red, base_HP, 0);
+		_citys.back() = std::make_unique<headquarter>(this, camp_label::blue, base_HP, city_count + 1);
 		for (int i = 1; i <= city_count; ++i)
-			_citys[i] = std::make_unique<city>(i);
+			_citys[i] = std::make_unique<city>(this, i);
+	}
+
+	game_controller::game_controller(const game_config& config, output_sink& output)
+		: game_controller(config.base_HP, config.city_count, config.lion_loyalty_reduce, config.end_time,
+			config.warrior_HP, config.warrior_force, output)
+	{}
+
+	game_controller::game_controller(const game_snapshot& snapshot, output_sink& output)
+		: game_controller(snapshot, snapshot.config(), output)
+	{}
+
+	game_controller::game_controller(const game_snapshot& snapshot, const game_config& config, output_sink& output)
+		: game_controller(config, output)
+	{
+		auto in = snapshot.body();
+		game_config saved;
+		in >> saved;
+		if (saved.city_count != config.city_count)
+			throw std::runtime_error("Snapshot has a different number of cities");
+		int game_over;
+		in >> game_over;
+		_game_over = game_over != 0;
+		get_headquarter(camp_label::red).load(in);
+		get_headquarter(camp_label::blue).load(in);
+		for (auto camp : { camp_label::red, camp_label::blue })
+			column(camp).load(this, camp, in);
+		// ½ʿʱǼǵķӻı
+		_scheduler.load(in);
 	}
 
-	game_controller::~game_controller()
+	game_snapshot game_controller::snapshot() const
 	{
-		// ÿȫֱ
-		_the_controller = nullptr;
+		std::string data(game_snapshot::magic);
+		snapshot_writer out(data);
+		game_config config{ base_HP, static_cast<int>(_citys.size()) - 2, lion_loyalty_reduce, end_time, warrior_HP, warrior_force };
+		out << game_snapshot::version << config << static_cast<int>(_game_over);
+		static_cast<const headquarter&>(*_citys.front()).save(out);
+		static_cast<const headquarter&>(*_citys.back()).save(out);
+		for (const auto& column : _columns)
+			column.save(out);
+		_scheduler.save(out);
+		return game_snapshot(std::move(data));
 	}
 
 	headquarter& game_controller::get_headquarter(camp_label camp)
@@ -458,126 +2254,185 @@ namespace warcraft
 		}
 	}
 
-	void game_controller::send_message(game_message msg, std::any param)
+	void game_controller::run_until(int last_time)
 	{
-		switch (msg) {
-		case game_message::game_over:
-			_game_over = true;
-			break;
-		}
-	}
-
-	void game_controller::run()
-	{
-		int time = 0;
-		for (; time <= end_time and !_game_over; ++time) {
+		last_time = std::min(last_time, end_time);
+		while (!_scheduler.empty() and !_game_over) {
+			// ûжǼǵʱʲôҲֱᷢ
+			if (_scheduler.next_time() > last_time)
+				break;
+			int time = _scheduler.pop();
 			// updatetime㴫
 			// controller->city->warrior->weapon
 			// game_objectӦдon_update_timeضʱһ
 			on_update_time(time);
-			for (auto& city : _citys) {
-				city->on_update_time(time);
+			// ûʿĳʲôҲֻᷢ˾ʿĳУ˳
+			_citys.front()->on_update_time(time);
+			// ֻвʿжķӣֻЩʿĳУûκͨҪʱ
+			if (unsigned kinds = active_warrior_kinds(minute(time)); kinds) {
+				if (_phase_pool and (minute(time) == 35 or minute(time) == 40))
+					update_cities_parallel(time, kinds);
+				else
+					for_each_occupied_city(kinds, [this, time](int index) { _citys[index]->on_update_time(time); });
 			}
+			_citys.back()->on_update_time(time);
+			_events.dispatch();
 		}
 	}
 
+	template<class F>
+	void game_controller::for_each_occupied_city(unsigned kinds, F&& f)
+	{
+		int last = _citys.size() - 1;
+		auto& red = column(camp_label::red), & blue = column(camp_label::blue);
+		int next_red = red.next_occupied(1, last - 1, kinds), next_blue = blue.next_occupied(1, last - 1, kinds);
+		while (std::min(next_red, next_blue) < last) {
+			// һеĶֻӰ챾еʿ
+			int index = std::min(next_red, next_blue);
+			f(index);
+			if (next_red == index)
+				next_red = red.next_occupied(index + 1, last - 1, kinds);
+			if (next_blue == index)
+				next_blue = blue.next_occupied(index + 1, last - 1, kinds);
+		}
+	}
+
+	bool game_controller::has_warrior(warrior_kind kind) noexcept
+	{
+		int last = _citys.size() - 1;
+		for (auto& column : _columns)
+			if (column.next_occupied(0, last, warrior_kind_bit(kind)) <= last)
+				return true;
+		return false;
+	}
+
 	void game_controller::on_update_time(int new_time)
 	{
 		switch (minute(new_time)) {
 		case 10:
 			warrior_move_forward(new_time);
 			break;
+		case 59: {
+			// ͷʿĿռ
+			profile_timer timer(profile_phase::cleanup);
+			profile_count(profile_counter::warriors_cleaned, _warrior_to_clean.size());
+			_warrior_to_clean.clear();
+			break;
+		}
 		}
 	}
 
 	void game_controller::warrior_move_forward([[maybe_unused]] int time)
 	{
-		int city_index = 0;
-		// ʿСĳƶ
-		for (; city_index < _citys.size() - 1; ++city_index) {
-			_citys[city_index]->warrior_of(camp_label::blue) = move(_citys[city_index + 1]->warrior_of(camp_label::blue));
-			if (_citys[city_index]->warrior_of(camp_label::blue))
-				_citys[city_index]->warrior_of(camp_label::blue)->_city = _citys[city_index].get();
-		}
-		// ʿŴĳƶ
-		for (; city_index > 0; --city_index) {
-			_citys[city_index]->warrior_of(camp_label::red) = move(_citys[city_index - 1]->warrior_of(camp_label::red));
-			if (_citys[city_index]->warrior_of(camp_label::red))
-				_citys[city_index]->warrior_of(camp_label::red)->_city = _citys[city_index].get();
-		}
+		profile_timer timer(profile_phase::march);
+		// ʿСĳƶʿŴĳƶ
+		column(camp_label::blue).advance();
+		column(camp_label::red).advance();
 		// Ƿһ˾ռ
 		if (get_headquarter(camp_label::red).warrior_of(camp_label::blue) or
 			get_headquarter(camp_label::blue).warrior_of(camp_label::red))
-			send_message(game_message::game_over);
+			publish(game_over_event{});
 	}
 
-	weapon::weapon(const std::string& name, int index, int durability) :
-		weapon_index(index), _durability(durability), game_object(name)
-	{}
-
-	weapon::~weapon() = default;
+	void marching_column::place(int city_index, warrior_ptr warrior) noexcept
+	{
+		int slot = slot_of(city_index);
+		_occupied[static_cast<int>(warrior->kind)][slot / 64] |= std::uint64_t(1) << slot % 64;
+		_slots[slot] = std::move(warrior);
+	}
 
-	std::unique_ptr<weapon> get_weapon(int index)
+	int marching_column::next_occupied(int first, int last, unsigned kinds) noexcept
 	{
-		switch (index) {
-		case 0:
-			return std::make_unique<sword>();
-		case 1:
-			return std::make_unique<bomb>();
-		case 2:
-			return std::make_unique<arrow>();
-		default:
-			return nullptr;
+		int size = _slots.size(), slot = slot_of(first);
+		// бʱλҲӣĩβص0
+		for (int city_index = first; city_index <= last;) {
+			int span = std::min({ 64 - slot % 64, last - city_index + 1, size - slot });
+			std::uint64_t bits = 0;
+			for (int kind = 0; kind < warrior_type_count; ++kind)
+				if (kinds >> kind & 1)
+					bits |= _occupied[kind][slot / 64];
+			bits >>= slot % 64;
+			if (span < 64)
+				bits &= (std::uint64_t(1) << span) - 1;
+			while (bits) {
+				int delta = lowest_bit(bits);
+				auto& warrior = _slots[slot + delta];
+				if (warrior and kinds & warrior_kind_bit(warrior->kind))
+					return city_index + delta;
+				// ʿѾ뿪򻻳࣬Щı
+				std::uint64_t mask = ~(std::uint64_t(1) << (slot + delta) % 64);
+				for (int kind = 0; kind < warrior_type_count; ++kind)
+					if (kinds >> kind & 1)
+						_occupied[kind][(slot + delta) / 64] &= mask;
+				bits &= bits - 1;
+			}
+			city_index += span;
+			slot = (slot + span) % size;
 		}
+		return last + 1;
 	}
 
-	// ʹõ˳
-	bool use_cmp(const weapon& weapon1, const weapon& weapon2)
+	void marching_column::advance() noexcept
 	{
-		return (weapon1.weapon_index < weapon2.weapon_index)
-			or (weapon1.weapon_index == weapon2.weapon_index and
-				weapon1.durability() < weapon2.durability());
+		_offset = wrap(_offset + 1);
+		// ԭյʿλ
+		int start = _direction > 0 ? 0 : _slots.size() - 1;
+		_slots[slot_of(start)].reset();
 	}
 
-	bool use_cmp_uptr(const std::unique_ptr<weapon>& weapon1, const std::unique_ptr<weapon>& weapon2)
+	void marching_column::save(snapshot_writer& out) const
 	{
-		return use_cmp(*weapon1, *weapon2);
+		int count = std::count_if(_slots.begin(), _slots.end(), [](const warrior_ptr& warrior) { return bool(warrior); });
+		out << _offset << count;
+		for (const auto& warrior : _slots)
+			if (warrior) {
+				out << static_cast<int>(warrior->kind) << warrior->id();
+				warrior->save(out);
+			}
 	}
 
-	// ͽɻ˳
-	bool snatch_cmp(const weapon& weapon1, const weapon& weapon2)
+	void marching_column::load(game_controller* controller, camp_label camp, snapshot_reader& in)
 	{
-		return (weapon1.weapon_index < weapon2.weapon_index)
-			or (weapon1.weapon_index == weapon2.weapon_index and
-				weapon1.durability() > weapon2.durability());
+		int count;
+		in >> _offset >> count;
+		if (_offset < 0 or _offset >= static_cast<int>(_slots.size()))
+			throw std::runtime_error("Corrupted snapshot");
+		for (auto& warrior : _slots)
+			warrior.reset();
+		for (auto& bits : _occupied)
+			std::fill(bits.begin(), bits.end(), 0);
+		for (; count > 0; --count) {
+			auto warrior = load_warrior(controller, camp, in);
+			int slot = warrior->slot();
+			if (slot < 0 or slot >= static_cast<int>(_slots.size()))
+				throw std::runtime_error("Corrupted snapshot");
+			place(city_of(slot), std::move(warrior));
+		}
 	}
 
-	bool snatch_cmp_uptr(const std::unique_ptr<weapon>& weapon1, const std::unique_ptr<weapon>& weapon2)
+	warrior::warrior(game_controller* controller, camp_label camp, int health_point, int force, int id, warrior_kind kind, int weapon_num) noexcept
+		: _camp(camp), _health_point(health_point), _force(force),
+		_id(id), _controller(controller),
+		_slot(controller->column(camp).slot_of(controller->headquarter_city(camp))),
+		kind(kind)
 	{
-		return snatch_cmp(*weapon1, *weapon2);
+		controller->subscribe_minutes(active_minutes(kind));
 	}
 
-	// ͬͬ;õΪȵ
-	bool operator==(const weapon& weapon1, const weapon& weapon2)
+	warrior::~warrior() = default;
+
+	void warrior::save(snapshot_writer& out) const
 	{
-		return weapon1.weapon_index == weapon2.weapon_index
-			and weapon1.durability() == weapon2.durability();
+		out << _slot << _health_point << _force << static_cast<int>(_weapons.pack());
 	}
 
-	bool operator==(const std::unique_ptr<weapon>& weapon1, const std::unique_ptr<weapon>& weapon2)
+	void warrior::load(snapshot_reader& in)
 	{
-		return *weapon1 == *weapon2;
+		int weapons;
+		in >> _slot >> _health_point >> _force >> weapons;
+		_weapons.unpack(static_cast<std::uint32_t>(weapons));
 	}
 
-	warrior::warrior(camp_label camp, int health_point, int force, int id, const std::string& type_name, int weapon_num) noexcept
-		: _camp(camp), _health_point(health_point), _force(force),
-		_id(id), type_name(type_name),
-		_city(&game_controller::get_controller().get_headquarter(camp)),
-		game_object(camp_name(camp) + ' ' + type_name + ' ' + std::to_string(id))
-	{}
-
-	warrior::~warrior() = default;
-
 	void warrior::on_update_time(int new_time)
 	{
 		switch (minute(new_time)) {
@@ -585,42 +2440,21 @@ namespace warcraft
 			show_weapon(new_time);
 			break;
 		}
-		for (auto& weapon : _weapons)
-			weapon->on_update_time(new_time);
 		game_object::on_update_time(new_time);
 	}
 
 	void warrior::show_weapon(int time) noexcept
 	{
-		std::array<int, weapon_type_count> count{ 0 };
-		for (const auto& weapon : _weapons)
-			++count[weapon->weapon_index];
-		std::cout << time_to_str(time) << ' '
-			<< name << " has ";
+		profile_timer timer(profile_phase::report);
+		weapon_report_record record{ time, _camp, kind, _id, {}, _health_point };
 		for (int index = 0; index < weapon_type_count; ++index)
-			std::cout << count[index] << ' ' << weapon_name(index) << ' ';
-		std::cout << "and " << _health_point << " elements" << std::endl;
-	}
-
-	void warrior::prefight() noexcept
-	{
-		std::sort(_weapons.begin(), _weapons.end(), use_cmp_uptr);
-	}
-
-	void warrior::postfight() noexcept
-	{
-		auto iter = _weapons.cbegin();
-		while (iter != _weapons.cend()) {
-			if ((*iter)->durability() == 0)
-				iter = _weapons.erase(iter);
-			else
-				++iter;
-		}
+			record.weapons[index] = _weapons.count(static_cast<weapon_kind>(index));
+		_controller->emit(record);
 	}
 
 	void warrior::on_attacking(weapon& weapon, warrior& aim) noexcept
 	{
-		if (weapon.name == "bomb")
+		if (weapon.kind == weapon_kind::bomb and hurt_by_own_bomb(kind))
 			_health_point -= weapon.force() / 2;
 		weapon.reduce_durability();
 	}
@@ -630,53 +2464,58 @@ namespace warcraft
 		_health_point -= weapon.force();
 	}
 
-	dragon::dragon(camp_label camp, int health_point, int force, int id, double morale) noexcept
-		: _morale(morale), warrior(camp, health_point, force, id, "dragon", 1)
+	dragon::dragon(game_controller* controller, camp_label camp, int health_point, int force, int id, double morale) noexcept
+		: _morale(morale), warrior(controller, camp, health_point, force, id, warrior_kind::dragon, 1)
 	{
-		_weapons.emplace_back(get_weapon(id % weapon_type_count));
+		_weapons.add(static_cast<weapon_kind>(id % weapon_type_count));
 	}
 
 	void dragon::on_alive(int time) noexcept
 	{
-		std::cout << time_to_str(time) << ' '
-			<< name << " yelled in " << _city->name << std::endl;
+		_controller->emit(dragon_yelled_record{ time, _camp, _id, current_city().city_id() });
 	}
 
-	ninja::ninja(camp_label camp, int health_point, int force, int id) noexcept
-		: warrior(camp, health_point, force, id, "ninja", 2)
+	void dragon::save(snapshot_writer& out) const
 	{
-		_weapons.emplace_back(get_weapon(id % weapon_type_count));
-		_weapons.emplace_back(get_weapon((id + 1) % weapon_type_count));
+		warrior::save(out);
+		out << _morale;
 	}
 
-	void ninja::on_attacking(weapon& weapon, warrior& aim) noexcept
+	void dragon::load(snapshot_reader& in)
 	{
-		if (weapon.name == "bomb") {
-			// ninjaʹbombʹԼ
-			int hp = _health_point;
-			warrior::on_attacking(weapon, aim);
-			_health_point = hp;
-		}
-		else {
-			warrior::on_attacking(weapon, aim);
-		}
+		warrior::load(in);
+		in >> _morale;
 	}
 
-	iceman::iceman(camp_label camp, int health_point, int force, int id) noexcept
-		: warrior(camp, health_point, force, id, "iceman", 1)
+	ninja::ninja(game_controller* controller, camp_label camp, int health_point, int force, int id) noexcept
+		: warrior(controller, camp, health_point, force, id, warrior_kind::ninja, 2)
 	{
-		_weapons.emplace_back(get_weapon(id % weapon_type_count));
+		_weapons.add(static_cast<weapon_kind>(id % weapon_type_count));
+		_weapons.add(static_cast<weapon_kind>((id + 1) % weapon_type_count));
 	}
 
-	lion::lion(camp_label camp, int health_point, int force, int id, int loyalty) noexcept
-		: _loyalty(loyalty), warrior(camp, health_point, force, id, "lion")
+	iceman::iceman(game_controller* controller, camp_label camp, int health_point, int force, int id) noexcept
+		: warrior(controller, camp, health_point, force, id, warrior_kind::iceman, 1)
 	{
-		_weapons.emplace_back(get_weapon(id % weapon_type_count));
+		_weapons.add(static_cast<weapon_kind>(id % weapon_type_count));
 	}
 
-	void lion::show_additional_information() const noexcept
+	lion::lion(game_controller* controller, camp_label camp, int health_point, int force, int id, int loyalty) noexcept
+		: _loyalty(loyalty), warrior(controller, camp, health_point, force, id, warrior_kind::lion)
 	{
-		std::cout << "Its loyalty is " << _loyalty << std::endl;
+		_weapons.add(static_cast<weapon_kind>(id % weapon_type_count));
+	}
+
+	void lion::save(snapshot_writer& out) const
+	{
+		warrior::save(out);
+		out << _loyalty;
+	}
+
+	void lion::load(snapshot_reader& in)
+	{
+		warrior::load(in);
+		in >> _loyalty;
 	}
 
 	void lion::on_update_time(int new_time)
@@ -692,16 +2531,16 @@ namespace warcraft
 	void lion::try_runaway(int time) noexcept
 	{
 		if (_loyalty <= 0) {
-			std::cout << time_to_str(time) << ' '
-				<< name << " ran away" << std::endl;
+			_controller->emit(lion_ran_away_record{ time, _camp, _id });
+			_controller->publish(lion_ran_away_event{ time, current_city().city_id(), _id, _camp });
 
 			// бӳɾ
-			_city->remove_warrior(_camp);
+			current_city().remove_warrior(_camp);
 		}
 	}
 
-	wolf::wolf(camp_label camp, int health_point, int force, int id) noexcept
-		: warrior(camp, health_point, force, id, "wolf")
+	wolf::wolf(game_controller* controller, camp_label camp, int health_point, int force, int id) noexcept
+		: warrior(controller, camp, health_point, force, id, warrior_kind::wolf)
 	{}
 
 	void wolf::on_update_time(int new_time)
@@ -716,42 +2555,30 @@ namespace warcraft
 
 	void wolf::snatch(int time) noexcept
 	{
+		profile_timer timer(profile_phase::snatch);
 		auto enemy = enemy_now();
-		if (!enemy or enemy->type_name == "wolf" or enemy->_weapons.empty())
+		if (!enemy or enemy->kind == warrior_kind::wolf or enemy->_weapons.empty())
 			return;
 
-		std::sort(enemy->_weapons.begin(), enemy->_weapons.end(), snatch_cmp_uptr);
-		auto iter = enemy->_weapons.cbegin();
-		auto index = (*iter)->weapon_index;
+		// ֻСһ
+		auto kind = enemy->_weapons.first_kind();
 		int capacity = max_weapon_count - _weapons.size();
-		int snatch_num = 0;
-		for (; snatch_num < capacity and
-			iter != enemy->_weapons.cend() and (*iter++)->weapon_index == index;
-			++snatch_num);
+		int snatch_num = enemy->_weapons.move_to(_weapons, capacity, kind);
+		profile_count(profile_counter::weapons_snatched, snatch_num);
 
-		std::cout << time_to_str(time) << ' '
-			<< name << " took "
-			<< snatch_num << ' ' << weapon_name(index)
-			<< " from " << enemy->name
-			<< " in " << _city->name << std::endl;
-
-		std::move(enemy->_weapons.begin(), enemy->_weapons.begin() + snatch_num,
-			std::back_inserter(_weapons));
-		enemy->_weapons.erase(enemy->_weapons.begin(), enemy->_weapons.begin() + snatch_num);
+		_controller->emit(weapon_snatched_record{ time, _camp, _id, snatch_num, kind, enemy->kind, enemy->id(), current_city().city_id() });
 	}
 
-	city::city(int id) noexcept
-		: city(id, "city " + std::to_string(id))
-	{}
-
-	city::city(int id, const std::string & name) noexcept
-		: _city_id(id), game_object(name)
-	{}
+	city::city(game_controller* controller, int id) noexcept
+		: _controller(controller), _city_id(id)
+	{
+		controller->subscribe_minutes(city_active_minutes);
+	}
 
 	void city::remove_warrior(camp_label camp)
 	{
 		if (warrior_of(camp))
-			_warrior_to_clean.emplace_back(move(warrior_of(camp)));
+			_controller->clean_later(std::move(warrior_of(camp)));
 	}
 
 	void city::on_update_time(int new_time)
@@ -763,13 +2590,10 @@ namespace warcraft
 		case 40:
 			fight(new_time);
 			break;
-		case 59:
-			// ͷʿĿռ
-			_warrior_to_clean.clear();
-			break;
 		}
-		for (auto& warrior : _warriors)
-			if (warrior)
+		// ֻ֪ͨһжʿ
+		for (auto camp : { camp_label::red, camp_label::blue })
+			if (auto& warrior = warrior_of(camp); warrior and active_minutes(warrior->kind) >> minute(new_time) & 1)
 				warrior->on_update_time(new_time);
 		game_object::on_update_time(new_time);
 	}
@@ -777,11 +2601,7 @@ namespace warcraft
 	void city::on_warrior_march_to(int time) noexcept
 	{
 		auto show_march_info = [&](const warrior& w) {
-			std::cout << time_to_str(time) << ' '
-				<< w.name << " marched to "
-				<< name << " with "
-				<< w.health_point() << " elements and force "
-				<< w.force() << std::endl;
+			_controller->emit(warrior_marched_record{ time, w.camp(), w.kind, w.id(), _city_id, w.health_point(), w.force() });
 		};
 		if (warrior_of(camp_label::red)) {
 			warrior_of(camp_label::red)->on_move_forward();
@@ -795,32 +2615,80 @@ namespace warcraft
 
 	void city::fight(int time) noexcept
 	{
-		for (const auto& warrior : _warriors)
-			if (!warrior)
-				return;
-		for (const auto& warrior : _warriors)
-			warrior->prefight();
+		if (!warrior_of(camp_label::red) or !warrior_of(camp_label::blue))
+			return;
+		profile_timer timer(profile_phase::fight);
+		profile_count(profile_counter::fights);
 		camp_label attacker_camp = (_city_id % 2 == 1 ? camp_label::red : camp_label::blue);
+		auto cache = _controller->shared_fight_cache();
+		fight_key key;
+		fight_result result;
+		if (cache) {
+			for (int camp = 0; camp < camp_count; ++camp) {
+				auto& warrior = *warrior_of(static_cast<camp_label>(camp));
+				key.health_point[camp] = warrior.health_point();
+				key.force[camp] = warrior.force();
+				key.weapons[camp] = warrior._weapons.pack();
+				key.hurt_by_own_bomb[camp] = hurt_by_own_bomb(warrior.kind);
+			}
+			key.attacker = camp_num(attacker_camp);
+			if (cache->find(key, result)) {
+				for (int camp = 0; camp < camp_count; ++camp) {
+					auto& warrior = *warrior_of(static_cast<camp_label>(camp));
+					warrior._health_point = result.health_point[camp];
+					warrior._weapons.unpack(result.weapons[camp]);
+				}
+				report_fight(time);
+				return;
+			}
+		}
+		switch (_controller->engine()) {
+		case fight_engine::classic:
+			fight_classic(attacker_camp);
+			break;
+		case fight_engine::soa:
+			fight_soa(attacker_camp);
+			break;
+		}
+		if (cache) {
+			for (int camp = 0; camp < camp_count; ++camp) {
+				auto& warrior = *warrior_of(static_cast<camp_label>(camp));
+				result.health_point[camp] = warrior.health_point();
+				result.weapons[camp] = warrior._weapons.pack();
+			}
+			cache->insert(key, result);
+		}
+		report_fight(time);
+	}
+
+	void city::fight_classic(camp_label attacker_camp) noexcept
+	{
+		// ʹ˳չ˫
+		std::array<static_vector<weapon, warrior::max_weapon_count>, camp_count> weapons;
+		for (int camp = 0; camp < camp_count; ++camp)
+			warrior_of(static_cast<camp_label>(camp))->_weapons.expand(std::back_inserter(weapons[camp]));
+
 		bool end_fight[camp_count]{ false };
 		bool end = false;
 		int weapon_to_use[camp_count]{ 0 };
 		while (!end) {
+			profile_count(profile_counter::fight_rounds);
 			auto& attacker = warrior_of(attacker_camp),
 				& attacked = warrior_of(enemy_camp(attacker_camp));
+			auto& attacker_weapons = weapons[camp_num(attacker_camp)];
 
 			bool has_effective_weapon = false;
-			for (int i = 0; i < attacker->weapon_count(); ++i) {
-				attacker->weapon_at(i).set_force(attacker->force());
-				if (attacker->weapon_at(i).durability() > 0 or
-					attacker->weapon_at(i).force() > 0)
+			for (auto& weapon : attacker_weapons) {
+				weapon.set_force(attacker->force());
+				if (weapon.durability() > 0 or weapon.force() > 0)
 					has_effective_weapon = true;
 			}
 			// ѡ
 			int weapon_index = weapon_to_use[camp_num(attacker_camp)],
 				delta_weapon_index = 0,
-				weapon_count = attacker->weapon_count();
+				weapon_count = attacker_weapons.size();
 			for (; delta_weapon_index < weapon_count; ++delta_weapon_index)
-				if (attacker->weapon_at((weapon_index + delta_weapon_index) % weapon_count).durability() != 0)
+				if (attacker_weapons[(weapon_index + delta_weapon_index) % weapon_count].durability() != 0)
 					break;
 			if (!has_effective_weapon or delta_weapon_index == weapon_count) { // 
 				end_fight[camp_num(attacker_camp)] = true;
@@ -828,7 +2696,8 @@ namespace warcraft
 			}
 			else { // 
 				weapon_index = (weapon_index + delta_weapon_index) % weapon_count;
-				auto& weapon_using = attacker->weapon_at(weapon_index);
+				auto& weapon_using = attacker_weapons[weapon_index];
+				profile_count(profile_counter::weapon_uses);
 				attacker->on_attacking(weapon_using, *attacked);
 				attacked->on_attacked(weapon_using, *attacker);
 
@@ -840,70 +2709,897 @@ namespace warcraft
 			// 
 			attacker_camp = enemy_camp(attacker_camp);
 		}
+
+		// ջٷŻ
+		for (int camp = 0; camp < camp_count; ++camp)
+			warrior_of(static_cast<camp_label>(camp))->_weapons.assign(weapons[camp].begin(), weapons[camp].end());
+	}
+
+	void city::fight_soa(camp_label attacker_camp) noexcept
+	{
+		fight_state state;
+		for (int camp = 0; camp < camp_count; ++camp) {
+			auto& warrior = *warrior_of(static_cast<camp_label>(camp));
+			state.health_point[camp] = warrior.health_point();
+			state.weapon_count[camp] = 0;
+			state.next_weapon[camp] = 0;
+			state.hurt_by_own_bomb[camp] = hurt_by_own_bomb(warrior.kind);
+			state.has_forceful_weapon[camp] = false;
+			state.stopped[camp] = false;
+			// ս䣬ֻһ
+			warrior._weapons.for_each([&](weapon_kind kind, int durability) {
+				int i = state.weapon_count[camp]++;
+				state.kind[camp][i] = kind;
+				state.durability[camp][i] = durability;
+				state.weapon_force[camp][i] = weapon_force(kind, warrior.force());
+				if (state.weapon_force[camp][i] > 0)
+					state.has_forceful_weapon[camp] = true;
+			});
+		}
+		state.resolve(camp_num(attacker_camp));
+		for (int camp = 0; camp < camp_count; ++camp) {
+			auto& warrior = *warrior_of(static_cast<camp_label>(camp));
+			warrior._health_point = state.health_point[camp];
+			// ٷŻ
+			warrior._weapons.clear();
+			for (int i = 0; i < state.weapon_count[camp]; ++i)
+				warrior._weapons.add(state.kind[camp][i], state.durability[camp][i]);
+		}
+	}
+
+	void fight_state::resolve(int attacker) noexcept
+	{
+		// ;δ(bomb, arrow)
+		std::array<int, camp_count> finite_left{ 0 };
+		for (int camp = 0; camp < camp_count; ++camp)
+			for (int i = 0; i < weapon_count[camp]; ++i)
+				if (durability[camp][i] > 0)
+					++finite_left[camp];
+		bool periodic_checked = false;
+		while (true) {
+			if (!periodic_checked and finite_left[0] == 0 and finite_left[1] == 0) {
+				if (resolve_periodic(attacker)) {
+					profile_count(profile_counter::periodic_fights);
+					return;
+				}
+				periodic_checked = true;
+			}
+			profile_count(profile_counter::fight_rounds);
+			int defender = 1 - attacker, count = weapon_count[attacker];
+			const auto& kind = this->kind[attacker];
+			auto& durability = this->durability[attacker];
+			// ;Ϊ0Ϊ0ҲЧ
+			bool has_effective_weapon = has_forceful_weapon[attacker];
+			for (int i = 0; i < count and !has_effective_weapon; ++i)
+				if (durability[i] > 0)
+					has_effective_weapon = true;
+			// ѡ
+			int chosen = -1;
+			for (int delta = 0; delta < count; ++delta) {
+				int i = (next_weapon[attacker] + delta) % count;
+				if (durability[i] != 0) {
+					chosen = i;
+					break;
+				}
+			}
+			if (!has_effective_weapon or chosen < 0) { // 
+				stopped[attacker] = true;
+				if (stopped[defender])
+					return;
+			}
+			else { // 
+				profile_count(profile_counter::weapon_uses);
+				int force = weapon_force[attacker][chosen];
+				// sword;ãbomb˵Լ
+				if (kind[chosen] == weapon_kind::bomb and hurt_by_own_bomb[attacker])
+					health_point[attacker] -= force / 2;
+				if (kind[chosen] != weapon_kind::sword and --durability[chosen] == 0)
+					--finite_left[attacker];
+				health_point[defender] -= force;
+				next_weapon[attacker] = (chosen + 1) % count;
+
+				// жǷ
+				if (health_point[attacker] <= 0 or health_point[defender] <= 0)
+					return;
+			}
+			// 
+			attacker = defender;
+		}
+	}
+
+	bool fight_state::resolve_periodic(int attacker) noexcept
+	{
+		// ʱ;òΪ0swordЧֻȡǷйΪ0
+		// ܽһÿغɵ˺swordĹ
+		std::array<bool, camp_count> attacks{ false };
+		std::array<int, camp_count> damage{ 0 };
+		for (int camp = 0; camp < camp_count; ++camp) {
+			for (int i = 0; i < weapon_count[camp]; ++i) {
+				if (kind[camp][i] == weapon_kind::sword) {
+					attacks[camp] = has_forceful_weapon[camp];
+					damage[camp] = weapon_force[camp][i];
+					break;
+				}
+			}
+		}
+		int defender = 1 - attacker;
+		// һҪٴβɱԷ0ʾԶ
+		auto hits_to_kill = [&](int camp) {
+			int aim = 1 - camp;
+			return attacks[camp] and damage[camp] > 0 ? (health_point[aim] + damage[camp] - 1) / damage[camp] : 0;
+		};
+		int attacker_hits = hits_to_kill(attacker), defender_hits = hits_to_kill(defender);
+		if (!attacks[attacker] and !attacks[defender]) // ˫ֹͣ
+			return true;
+		if (attacker_hits == 0 and defender_hits == 0) // ֹ˺
+			return false;
+		// attackerȹkιdefenderĵkι֮ǰ
+		if (defender_hits == 0 or (attacker_hits != 0 and attacker_hits <= defender_hits)) {
+			health_point[defender] -= attacker_hits * damage[attacker];
+			health_point[attacker] -= (attacks[defender] ? attacker_hits - 1 : 0) * damage[defender];
+		}
+		else {
+			health_point[attacker] -= defender_hits * damage[defender];
+			health_point[defender] -= (attacks[attacker] ? defender_hits : 0) * damage[attacker];
+		}
+		return true;
+	}
+
+	std::size_t fight_cache::key_hash::operator()(const fight_key& key) const noexcept
+	{
+		std::uint64_t hash = key.attacker;
+		auto mix = [&hash](std::uint64_t value) {
+			hash = (hash ^ value) * 0x9e3779b97f4a7c15;
+			hash ^= hash >> 32;
+		};
+		for (int camp = 0; camp < camp_count; ++camp) {
+			mix(static_cast<std::uint32_t>(key.health_point[camp]) | std::uint64_t(key.hurt_by_own_bomb[camp]) << 32);
+			mix(static_cast<std::uint32_t>(key.force[camp]) | std::uint64_t(key.weapons[camp]) << 32);
+		}
+		return hash;
+	}
+
+	fight_cache::fight_cache(std::size_t capacity)
+		: _capacity(std::max<std::size_t>(capacity, 1))
+	{
+		_entries.reserve(_capacity);
+		_index.reserve(_capacity);
+	}
+
+	bool fight_cache::find(const fight_key& key, fight_result& result)
+	{
+		std::lock_guard lock(_mutex);
+		auto found = _index.find(key);
+		if (found == _index.end()) {
+			++_misses;
+			return false;
+		}
+		++_hits;
+		auto& entry = _entries[found->second];
+		entry.referenced = true;
+		result = entry.result;
+		return true;
+	}
+
+	void fight_cache::insert(const fight_key& key, const fight_result& result)
+	{
+		std::lock_guard lock(_mutex);
+		// ߳̿Ѿͬһ
+		if (_index.count(key))
+			return;
+		if (_entries.size() < _capacity) {
+			_index.emplace(key, static_cast<int>(_entries.size()));
+			_entries.push_back({ key, result, false });
+			return;
+		}
+		while (_entries[_hand].referenced) {
+			_entries[_hand].referenced = false;
+			_hand = (_hand + 1) % _capacity;
+		}
+		auto& victim = _entries[_hand];
+		_index.erase(victim.key);
+		++_evictions;
+		victim = { key, result, false };
+		_index.emplace(key, static_cast<int>(_hand));
+		_hand = (_hand + 1) % _capacity;
+	}
+
+	void fight_cache::report(std::ostream& out) const
+	{
+		std::lock_guard lock(_mutex);
+		auto lookups = _hits + _misses;
+		out << std::fixed << std::setprecision(1)
+			<< "fight cache       " << std::setw(14) << _entries.size() << " entries\n"
+			<< "cache hits        " << std::setw(14) << _hits << '\n'
+			<< "cache misses      " << std::setw(14) << _misses << '\n'
+			<< "cache evictions   " << std::setw(14) << _evictions << '\n'
+			<< "cache hit rate    " << std::setw(13) << (lookups ? 100.0 * _hits / lookups : 0.0) << '%' << '\n';
+	}
+
+	void city::report_fight(int time) noexcept
+	{
+		auto& red = *warrior_of(camp_label::red), & blue = *warrior_of(camp_label::blue);
+		_controller->publish(fight_ended_event{ time, _city_id, red.health_point(), blue.health_point() });
+		_controller->emit(fight_record{ time, _city_id, red.kind, red.id(), red.health_point(), blue.kind, blue.id(), blue.health_point() });
 		if ((warrior_of(camp_label::red)->health_point() <= 0 and
 			warrior_of(camp_label::blue)->health_point() <= 0)) {
 			// ˫ս
-			std::cout << time_to_str(time) << " both "
-				<< warrior_of(camp_label::red)->name << " and "
-				<< warrior_of(camp_label::blue)->name << " died in "
-				<< name << std::endl;
 			remove_warrior(camp_label::red);
 			remove_warrior(camp_label::blue);
 		}
 		else if ((warrior_of(camp_label::red)->health_point() > 0 and
 			warrior_of(camp_label::blue)->health_point() > 0)) {
 			// ˫
-			std::cout << time_to_str(time) << " both "
-				<< warrior_of(camp_label::red)->name << " and "
-				<< warrior_of(camp_label::blue)->name << " were alive in "
-				<< name << std::endl;
-			warrior_of(camp_label::red)->postfight();
 			warrior_of(camp_label::red)->on_alive(time);
-			warrior_of(camp_label::blue)->postfight();
 			warrior_of(camp_label::blue)->on_alive(time);
 		}
 		else {
 			// һսʤһ
 			auto& winner = (warrior_of(camp_label::red)->health_point() > 0 ? warrior_of(camp_label::red) : warrior_of(camp_label::blue));
 			auto loser = winner->enemy_now();
-			std::cout << time_to_str(time) << ' '
-				<< winner->name << " killed " << loser->name
-				<< " in " << name
-				<< " remaining " << winner->health_point() << " elements"
-				<< std::endl;
 
 			// ɻ
-			loser->postfight();
-			winner->postfight();
-
-			std::sort(loser->_weapons.begin(), loser->_weapons.end(), snatch_cmp_uptr);
 			int capacity = warrior::max_weapon_count - winner->_weapons.size();
-			int snatch_num = std::min(capacity, loser->weapon_count());
-			std::move(loser->_weapons.begin(), loser->_weapons.begin() + snatch_num,
-				std::back_inserter(winner->_weapons));
+			loser->_weapons.move_to(winner->_weapons, capacity);
 
 			winner->on_alive(time);
 			remove_warrior(loser->camp());
 		}
 	}
+
+	// ȡ̳߳
+	// ÿ߳ԼУӶȡ
+	// ԼĶп˾ʹ̵߳Ķβȡ
+	class thread_pool {
+	private:
+		struct task_queue {
+			std::mutex mutex;
+			std::deque<int> tasks;
+		};
+
+		std::vector<task_queue> _queues;
+		std::vector<std::thread> _threads;
+
+		std::mutex _mutex;
+		std::condition_variable _wake, _done;
+		const std::function<void(int)>* _task = nullptr;
+		std::atomic<int> _remaining{ 0 };
+		// ÿύһһڻѹ߳
+		int _generation = 0;
+		bool _stopping = false;
+	public:
+		explicit thread_pool(int thread_count);
+		~thread_pool();
+
+		int thread_count() const noexcept { return _threads.size(); }
+		// ִtask(0), task(1), ..., task(task_count - 1)ȫɺ󷵻
+		void run(int task_count, const std::function<void(int)>& task);
+	private:
+		bool take_task(int self, int& task);
+		void work(int self);
+	};
+
+	thread_pool::thread_pool(int thread_count)
+		: _queues(thread_count)
+	{
+		for (int i = 0; i < thread_count; ++i)
+			_threads.emplace_back(&thread_pool::work, this, i);
+	}
+
+	thread_pool::~thread_pool()
+	{
+		{
+			std::lock_guard lock(_mutex);
+			_stopping = true;
+		}
+		_wake.notify_all();
+		for (auto& thread : _threads)
+			thread.join();
+	}
+
+	void thread_pool::run(int task_count, const std::function<void(int)>& task)
+	{
+		if (task_count == 0)
+			return;
+		{
+			std::lock_guard lock(_mutex);
+			_task = &task;
+			_remaining = task_count;
+			// ָͬһ߳
+			for (int i = 0; i < task_count; ++i) {
+				auto& queue = _queues[static_cast<long long>(i) * _queues.size() / task_count];
+				std::lock_guard queue_lock(queue.mutex);
+				queue.tasks.push_back(i);
+			}
+			++_generation;
+		}
+		_wake.notify_all();
+		std::unique_lock lock(_mutex);
+		_done.wait(lock, [this] { return _remaining == 0; });
+	}
+
+	bool thread_pool::take_task(int self, int& task)
+	{
+		{
+			auto& queue = _queues[self];
+			std::lock_guard lock(queue.mutex);
+			if (!queue.tasks.empty()) {
+				task = queue.tasks.front();
+				queue.tasks.pop_front();
+				return true;
+			}
+		}
+		for (std::size_t delta = 1; delta < _queues.size(); ++delta) {
+			auto& queue = _queues[(self + delta) % _queues.size()];
+			std::lock_guard lock(queue.mutex);
+			if (!queue.tasks.empty()) {
+				task = queue.tasks.back();
+				queue.tasks.pop_back();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void thread_pool::work(int self)
+	{
+		int generation = 0;
+		while (true) {
+			{
+				std::unique_lock lock(_mutex);
+				_wake.wait(lock, [&] { return _stopping or _generation != generation; });
+				if (_stopping)
+					return;
+				generation = _generation;
+			}
+			int task;
+			while (take_task(self, task)) {
+				(*_task)(task);
+				if (--_remaining == 0) {
+					std::lock_guard lock(_mutex);
+					_done.notify_all();
+				}
+			}
+		}
+	}
+
+	// ʱʽܶԱȣtime_to_strֱд뻺game_time
+	void benchmark_time_format(int iterations, output_sink& report)
+	{
+		using clock = std::chrono::steady_clock;
+		auto ns_per_call = [&](clock::time_point start) {
+			return static_cast<int>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count() / iterations);
+		};
+		constexpr int max_time = 6000;
+		std::size_t checksum = 0;
+
+		auto start = clock::now();
+		for (int i = 0; i < iterations; ++i)
+			checksum += time_to_str(i % max_time).size();
+		int legacy = ns_per_call(start);
+
+		memory_sink sink;
+		start = clock::now();
+		for (int i = 0; i < iterations; ++i) {
+			if (i % 4096 == 0)
+				sink.clear();
+			sink << game_time{ i % max_time };
+		}
+		checksum += sink.str().size();
+		int direct = ns_per_call(start);
+
+		report << "time_to_str: " << legacy << " ns/call\n"
+			<< "game_time: " << direct << " ns/call\n"
+			<< "checksum: " << static_cast<int>(checksum % 1000) << '\n';
+		report.flush();
+	}
+
+	void game_controller::update_cities_parallel(int time, unsigned kinds)
+	{
+		_phase_cities.clear();
+		for_each_occupied_city(kinds, [this](int index) { _phase_cities.push_back(index); });
+		int city_count = _phase_cities.size();
+		if (city_count < parallel_phase_threshold) {
+			for (int index : _phase_cities)
+				_citys[index]->on_update_time(time);
+			return;
+		}
+
+		// һγΪһ飬ÿһ
+		int group_count = std::min(city_count / (parallel_phase_threshold / 4), 4 * _phase_pool->thread_count());
+		if (_phase_buffers.size() < static_cast<std::size_t>(group_count))
+			_phase_buffers.resize(group_count);
+		_phase_pool->run(group_count, [this, time, city_count, group_count](int group) {
+			_phase_buffer = &_phase_buffers[group];
+			int first = static_cast<long long>(city_count) * group / group_count,
+				last = static_cast<long long>(city_count) * (group + 1) / group_count;
+			for (int i = first; i < last; ++i)
+				_citys[_phase_cities[i]]->on_update_time(time);
+			_phase_buffer = nullptr;
+		});
+
+		for (int group = 0; group < group_count; ++group) {
+			auto& buffer = _phase_buffers[group];
+			// ûmemory_sinkܻûлܰѿָ봫memcpy
+			if (!buffer.output.str().empty())
+				_output << buffer.output.str();
+			buffer.output.clear();
+			if (_recording and !buffer.recording.str().empty())
+				*_recording << buffer.recording.str();
+			buffer.recording.clear();
+			for (auto& warrior : buffer.warrior_to_clean)
+				_warrior_to_clean.push_back(std::move(warrior));
+			buffer.warrior_to_clean.clear();
+			for (const auto& event : buffer.events)
+				std::visit([this](const auto& event) { _events.publish(event); }, event);
+			buffer.events.clear();
+		}
+	}
+
+	// ѡ
+	struct run_options {
+		// е߳Ϊ1ʱ
+		int jobs = 1;
+		// ÿϷдڴд
+		bool memory_sink = false;
+		// ͬʱսУǷһ
+		bool validate = false;
+		// ѹÿ̳߳ظеĴΪ0ʱѹ
+		int stress_rounds = 0;
+		// Ϸڷֽ׶βе߳Ϊ1ʱ
+		int phase_jobs = 1;
+		// ʱһʱ̱ղӿջָΪ-1ʱʹÿ
+		int checkpoint = -1;
+		// ɨģʽøͬĲ
+		bool sweep = false;
+		// սΪ0ʱʹû
+		int fight_cache_size = 0;
+		fight_engine engine = fight_engine::soa;
+	};
+
+	// еgame_indexϷдoutput
+	// phase_poolΪnullptrʱÿڲսϷֳв
+	// recordingΪnullptrʱͬʱѻط־дrecording
+	// cacheΪnullptrʱսcacheвҽ
+	void run_game(int game_index, const game_config& config, fight_engine engine, output_sink& output,
+		thread_pool* phase_pool = nullptr, output_sink* recording = nullptr, fight_cache* cache = nullptr)
+	{
+		game_controller controller(config, output);
+		controller.set_fight_engine(engine);
+		controller.set_phase_pool(phase_pool);
+		controller.set_recording(recording);
+		controller.set_fight_cache(cache);
+		controller.emit(game_started_record{ 0, game_index, config.city_count });
+		controller.run();
+	}
+
+	// еcheckpointʱ̺󱣴գԭcontrollerӿջָе
+	// Ӧrun_gameȫͬڼǷphase_poolrecordingcacheĺrun_gameͬ
+	void run_game_from_checkpoint(int game_index, const game_config& config, fight_engine engine, output_sink& output,
+		int checkpoint, thread_pool* phase_pool = nullptr, output_sink* recording = nullptr, fight_cache* cache = nullptr)
+	{
+		game_snapshot snapshot;
+		{
+			game_controller controller(config, output);
+			controller.set_fight_engine(engine);
+			controller.set_phase_pool(phase_pool);
+			controller.set_recording(recording);
+			controller.set_fight_cache(cache);
+			controller.emit(game_started_record{ 0, game_index, config.city_count });
+			controller.run_until(checkpoint);
+			snapshot = game_snapshot(std::string(controller.snapshot().data()));
+		}
+		game_controller restored(snapshot, output);
+		restored.set_fight_engine(engine);
+		restored.set_phase_pool(phase_pool);
+		restored.set_recording(recording);
+		restored.set_fight_cache(cache);
+		restored.run();
+	}
+
+	// ֱclassicsoaУclassicĽ
+	// return: Ƿһ
+	bool validate_game(int game_index, const game_config& config, output_sink& output)
+	{
+		memory_sink classic, soa;
+		run_game(game_index, config, fight_engine::classic, classic);
+		run_game(game_index, config, fight_engine::soa, soa);
+		output << classic.str();
+		return classic.str() == soa.str();
+	}
+
+	// ģʽϷ໥̳߳ϲ
+	// ÿֵдԼĻȫɺ"Case N:"˳
+	// recordingΪnullptrʱֵĻط־ҲдԼĻٰͬ˳дrecording
+	// return: ģʽоֵǷһ
+	bool run_batch(const std::vector<game_config>& games, const run_options& options, output_sink& output,
+		output_sink* recording = nullptr, fight_cache* cache = nullptr)
+	{
+		std::vector<memory_sink> results(games.size()), recordings(recording ? games.size() : 0);
+		std::atomic<bool> consistent = true;
+		thread_pool pool(options.jobs);
+		pool.run(games.size(), [&](int index) {
+			if (options.validate) {
+				if (!validate_game(index + 1, games[index], results[index]))
+					consistent = false;
+			}
+			else if (options.checkpoint >= 0) {
+				run_game_from_checkpoint(index + 1, games[index], options.engine, results[index], options.checkpoint, nullptr,
+					recording ? &recordings[index] : nullptr, cache);
+			}
+			else {
+				run_game(index + 1, games[index], options.engine, results[index], nullptr,
+					recording ? &recordings[index] : nullptr, cache);
+			}
+		});
+		for (const auto& result : results)
+			output << result.str();
+		for (const auto& log : recordings)
+			*recording << log.str();
+		output.flush();
+		return consistent;
+	}
+
+	// ɨеһ֣lion_loyalty_reduceend_timeͬmembersǾgamesе±
+	// lion_loyalty_reduceֻlionǰʱãԵһlionǰ֮ǰȫֻͬģһΣ
+	// ֮ӿΪÿlion_loyalty_reduceֲһΡend_timeͬľֻͬһڲͬʱ̽ضϣ
+	// ÿֻ֧еend_timeľֽȡǰ׺
+	void run_sweep_group(const std::vector<game_config>& games, const std::vector<int>& members, fight_engine engine,
+		std::vector<memory_sink>& results, fight_cache* cache)
+	{
+		// end_timeĲͬضʱ̣Լʱ̶Ӧ
+		auto cut_times = [&](auto&& selected) {
+			std::vector<int> times;
+			for (int index : members)
+				if (selected(games[index]))
+					times.push_back(games[index].end_time);
+			std::sort(times.begin(), times.end());
+			times.erase(std::unique(times.begin(), times.end()), times.end());
+			return times;
+		};
+		auto cut_length = [](const std::vector<std::pair<int, std::size_t>>& cuts, int time) {
+			return std::lower_bound(cuts.begin(), cuts.end(), std::make_pair(time, std::size_t(0)))->second;
+		};
+		auto write_case = [&](int index, std::string_view shared, std::string_view own) {
+			int city_count = games[index].city_count;
+			record_formatter(results[index], city_count)(game_started_record{ 0, index + 1, city_count });
+			// յmemory_sinkûлܰѿָ봫memcpy
+			for (auto part : { shared, own })
+				if (!part.empty())
+					results[index] << part;
+		};
+
+		auto times = cut_times([](const game_config&) { return true; });
+		game_config config = games[members.front()];
+		config.end_time = times.back();
+		memory_sink shared_output;
+		game_controller shared(config, shared_output);
+		shared.set_fight_engine(engine);
+		shared.set_fight_cache(cache);
+
+		// òСʱе10(ǰ)֮ǰϳlionʱֹͣ
+		std::vector<std::pair<int, std::size_t>> shared_cuts;
+		auto next_time = times.begin();
+		int fork_time = 0;
+		for (int hour_start = 0; ; hour_start += 60) {
+			fork_time = std::min(hour_start + 9, config.end_time);
+			for (; next_time != times.end() and *next_time <= fork_time; ++next_time) {
+				shared.run_until(*next_time);
+				shared_cuts.emplace_back(*next_time, shared_output.str().size());
+			}
+			shared.run_until(fork_time);
+			if (fork_time == config.end_time or shared.game_over() or shared.has_warrior(warrior_kind::lion))
+				break;
+		}
+		// ϷѾʱ֮ͬ
+		if (shared.game_over())
+			for (; next_time != times.end(); ++next_time)
+				shared_cuts.emplace_back(*next_time, shared_output.str().size());
+		for (int index : members)
+			if (games[index].end_time <= fork_time or shared.game_over())
+				write_case(index, shared_output.str().substr(0, cut_length(shared_cuts, games[index].end_time)), {});
+		if (next_time == times.end())
+			return;
+
+		auto snapshot = shared.snapshot();
+		std::vector<int> reduces;
+		for (int index : members)
+			if (games[index].end_time > fork_time)
+				reduces.push_back(games[index].lion_loyalty_reduce);
+		std::sort(reduces.begin(), reduces.end());
+		reduces.erase(std::unique(reduces.begin(), reduces.end()), reduces.end());
+		for (int reduce : reduces) {
+			auto branch_times = cut_times([fork_time, reduce](const game_config& game) {
+				return game.end_time > fork_time and game.lion_loyalty_reduce == reduce;
+			});
+			config.lion_loyalty_reduce = reduce;
+			config.end_time = branch_times.back();
+			memory_sink branch_output;
+			game_controller branch(snapshot, config, branch_output);
+			branch.set_fight_engine(engine);
+			branch.set_fight_cache(cache);
+			std::vector<std::pair<int, std::size_t>> branch_cuts;
+			for (int time : branch_times) {
+				branch.run_until(time);
+				branch_cuts.emplace_back(time, branch_output.str().size());
+			}
+			for (int index : members)
+				if (games[index].end_time > fork_time and games[index].lion_loyalty_reduce == reduce)
+					write_case(index, shared_output.str(), branch_output.str().substr(0, cut_length(branch_cuts, games[index].end_time)));
+		}
+	}
+
+	// ɨģʽ໥jobs1ʱ̳߳ϲи
+	// ȫͬ
+	void run_sweep(const std::vector<game_config>& games, const run_options& options, output_sink& output,
+		fight_cache* cache = nullptr)
+	{
+		std::map<std::tuple<int, int, std::array<int, warrior_type_count>, std::array<int, warrior_type_count>>, std::vector<int>> groups;
+		for (int index = 0; index < static_cast<int>(games.size()); ++index) {
+			const auto& game = games[index];
+			groups[{ game.base_HP, game.city_count, game.warrior_HP, game.warrior_force }].push_back(index);
+		}
+		std::vector<const std::vector<int>*> members;
+		for (const auto& group : groups)
+			members.push_back(&group.second);
+
+		std::vector<memory_sink> results(games.size());
+		auto run_group = [&](int group) { run_sweep_group(games, *members[group], options.engine, results, cache); };
+		if (options.jobs > 1) {
+			thread_pool pool(options.jobs);
+			pool.run(members.size(), run_group);
+		}
+		else {
+			for (int group = 0; group < static_cast<int>(members.size()); ++group)
+				run_group(group);
+		}
+		for (const auto& result : results)
+			output << result.str();
+		output.flush();
+	}
+
+	// ѹԣcontrollerͬʱʱֵӰ
+	// еõοͬһ߳ͬʱоֵcontrollerУ
+	// ̳߳ϰÿظstress_roundsΣοͬ
+	// return: Ƿͬ
+	bool stress_games(const std::vector<game_config>& games, const run_options& options, output_sink& output)
+	{
+		int game_count = games.size();
+		std::vector<memory_sink> expected(game_count);
+		for (int index = 0; index < game_count; ++index)
+			run_game(index + 1, games[index], options.engine, expected[index]);
+		bool consistent = true;
+
+		{
+			std::vector<memory_sink> results(game_count);
+			std::vector<std::unique_ptr<game_controller>> controllers;
+			for (int index = 0; index < game_count; ++index) {
+				controllers.push_back(std::make_unique<game_controller>(games[index], results[index]));
+				controllers.back()->set_fight_engine(options.engine);
+				controllers.back()->emit(game_started_record{ 0, index + 1, games[index].city_count });
+			}
+			for (int index = game_count - 1; index >= 0; --index)
+				controllers[index]->run();
+			for (int index = 0; index < game_count; ++index)
+				if (results[index].str() != expected[index].str())
+					consistent = false;
+		}
+
+		std::atomic<bool> parallel_consistent = true;
+		int thread_count = options.jobs > 1 ? options.jobs : std::max(2u, std::thread::hardware_concurrency());
+		thread_pool pool(thread_count);
+		pool.run(game_count * options.stress_rounds, [&](int task) {
+			int index = task % game_count;
+			memory_sink result;
+			run_game(index + 1, games[index], options.engine, result);
+			if (result.str() != expected[index].str())
+				parallel_consistent = false;
+		});
+
+		for (const auto& result : expected)
+			output << result.str();
+		output.flush();
+		return consistent and parallel_consistent;
+	}
 }
 
-int main()
+// ÷Warcraft3 [--jobs N] [--sink direct|memory] [--output FILE] [--engine classic|soa] [--validate] [--stress N] [--phase-jobs N] [--checkpoint T]
+//                 [--record FILE] [--replay] [--replay-until T] [--sweep] [--fight-cache N]
+// --jobs N     ģʽN̲߳иϷNΪ0ʱʹȫ
+// --sink       direct(Ĭ)ֱдļ
+//              memoryÿϷдڴ棬һֽд
+// --output     FILEǱ׼
+// --engine     սģⷽʽclassicغʹʿsoa(Ĭ)ʹ鲢ֱֻʣswordĽ׶
+// --validate   ս涼һ飬classicĽһʱ1
+// --stress N   ͬʱڶcontroller߳ظN֣вһʱ1
+// --phase-jobs N  ÿڲսN̰߳вУʺϳмĵϷ--jobs--validate--stressͬ
+// --checkpoint T  еTʱ̺󱣴գӿջָУֱͬ--jobsͬã--validate--stressͬ
+// --record FILE  ͬʱѶƵĻط־дFILE--jobs--checkpointͬã--sweep--validate--stressͬ
+// --replay     --recordдĻط־Ϸֱؽı
+// --replay-until T  ͬ--replayֻTʱ̵ļ¼
+//              طֻؽıָܻϷ״̬У;ʹÿ(--checkpoint)
+// --fight-cache N  NսĽڱ׼
+// --sweep      ɨ裺end_timelion_loyalty_reduceͬľֹģ̣--jobsͬ
+//              ֵдڴ棬--sink memoryͬ--validate--stress--checkpoint--phase-jobsͬ
+// ʱWARCRAFT_PROFILEʱڱ׼׶εĺʱͼ
+// --bench-format N  ϷʱʽNܶԱ
+int main(int argc, char* argv[])
 {
+	warcraft::run_options options;
+	const char* output_path = nullptr;
+	const char* record_path = nullptr;
+	bool replay = false;
+	int replay_until = std::numeric_limits<int>::max();
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--jobs") == 0 and i + 1 < argc) {
+			options.jobs = std::atoi(argv[++i]);
+			if (options.jobs <= 0)
+				options.jobs = std::max(1u, std::thread::hardware_concurrency());
+		}
+		else if (std::strcmp(argv[i], "--sink") == 0 and i + 1 < argc
+			and (std::strcmp(argv[i + 1], "direct") == 0 or std::strcmp(argv[i + 1], "memory") == 0)) {
+			options.memory_sink = std::strcmp(argv[++i], "memory") == 0;
+		}
+		else if (std::strcmp(argv[i], "--output") == 0 and i + 1 < argc) {
+			output_path = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--engine") == 0 and i + 1 < argc
+			and (std::strcmp(argv[i + 1], "classic") == 0 or std::strcmp(argv[i + 1], "soa") == 0)) {
+			options.engine = std::strcmp(argv[++i], "soa") == 0 ? warcraft::fight_engine::soa : warcraft::fight_engine::classic;
+		}
+		else if (std::strcmp(argv[i], "--validate") == 0) {
+			options.validate = true;
+		}
+		else if (std::strcmp(argv[i], "--phase-jobs") == 0 and i + 1 < argc) {
+			options.phase_jobs = std::atoi(argv[++i]);
+			if (options.phase_jobs <= 0)
+				options.phase_jobs = std::max(1u, std::thread::hardware_concurrency());
+		}
+		else if (std::strcmp(argv[i], "--record") == 0 and i + 1 < argc) {
+			record_path = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--replay") == 0) {
+			replay = true;
+		}
+		else if (std::strcmp(argv[i], "--replay-until") == 0 and i + 1 < argc) {
+			replay = true;
+			replay_until = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--checkpoint") == 0 and i + 1 < argc) {
+			options.checkpoint = std::max(0, std::atoi(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "--fight-cache") == 0 and i + 1 < argc) {
+			options.fight_cache_size = std::max(0, std::atoi(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "--sweep") == 0) {
+			options.sweep = true;
+		}
+		else if (std::strcmp(argv[i], "--stress") == 0 and i + 1 < argc) {
+			options.stress_rounds = std::max(1, std::atoi(argv[++i]));
+		}
+		else if (std::strcmp(argv[i], "--bench-format") == 0 and i + 1 < argc) {
+			warcraft::benchmark_time_format(std::max(1, std::atoi(argv[++i])), warcraft::standard_output());
+			return 0;
+		}
+		else {
+			std::cerr << "unknown option: " << argv[i] << std::endl;
+			return 1;
+		}
+	}
+
+	// ɨиֹģ̣ÿϷ
+	if (options.sweep and (options.validate or options.stress_rounds > 0 or options.checkpoint >= 0 or options.phase_jobs > 1)) {
+		std::cerr << "--sweep cannot be used with --validate, --stress, --checkpoint or --phase-jobs" << std::endl;
+		return 1;
+	}
+	// ѹģʽԼÿϷ
+	if (options.checkpoint >= 0 and (options.validate or options.stress_rounds > 0)) {
+		std::cerr << "--checkpoint cannot be used with --validate or --stress" << std::endl;
+		return 1;
+	}
+	// ѹģʽÿϷһ߳Уֽ׶β
+	if (options.phase_jobs > 1 and (options.jobs > 1 or options.validate or options.stress_rounds > 0)) {
+		std::cerr << "--phase-jobs cannot be used with --jobs, --validate or --stress" << std::endl;
+		return 1;
+	}
+	// ЩģʽһÿϷ޷дط־
+	if (record_path and (replay or options.sweep or options.validate or options.stress_rounds > 0)) {
+		std::cerr << "--record cannot be used with --replay, --sweep, --validate or --stress" << std::endl;
+		return 1;
+	}
+
+	std::unique_ptr<warcraft::fd_sink> file_output, recording;
+	try {
+		if (output_path)
+			file_output = std::make_unique<warcraft::fd_sink>(output_path);
+		if (record_path) {
+			recording = std::make_unique<warcraft::fd_sink>(record_path);
+			*recording << warcraft::replay_reader::magic;
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	auto& output = file_output ? *file_output : warcraft::standard_output();
+
+	if (replay) {
+		warcraft::input_reader input(0);
+		try {
+			warcraft::replay(input.rest(), output, replay_until);
+		}
+		catch (const std::exception& e) {
+			output.flush();
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+		output.flush();
+		return warcraft::report_write_error(output, "output") ? 1 : 0;
+	}
+	warcraft::memory_sink case_output;
+	bool consistent = true;
+	std::unique_ptr<warcraft::thread_pool> phase_pool;
+	if (options.phase_jobs > 1)
+		phase_pool = std::make_unique<warcraft::thread_pool>(options.phase_jobs);
+	std::unique_ptr<warcraft::fight_cache> cache;
+	if (options.fight_cache_size > 0)
+		cache = std::make_unique<warcraft::fight_cache>(options.fight_cache_size);
+
+	warcraft::input_reader input(0);
 	int game_count;
-	std::cin >> game_count;
+	input >> game_count;
+	std::vector<warcraft::game_config> games;
 	for (int game_index = 1; game_index <= game_count; ++game_index) {
-		int hp_base, citys, loyalty, time;
-		std::array<int, warcraft::warrior_type_count> hp, force;
-		std::cin >> hp_base >> citys >> loyalty >> time;
+		warcraft::game_config config;
+		input >> config.base_HP >> config.city_count >> config.lion_loyalty_reduce >> config.end_time;
 		for (int i = 0; i < warcraft::warrior_type_count; ++i)
-			std::cin >> hp[i];
+			input >> config.warrior_HP[i];
 		for (int i = 0; i < warcraft::warrior_type_count; ++i)
-			std::cin >> force[i];
-		warcraft::game_controller controller(hp_base, citys, loyalty, time, hp, force);
-		
-		std::cout << "Case " << game_index << ':' << std::endl; 
-		controller.run();
+			input >> config.warrior_force[i];
+		if (options.jobs > 1 or options.stress_rounds > 0 or options.sweep) {
+			games.push_back(config);
+		}
+		else if (options.validate) {
+			if (!warcraft::validate_game(game_index, config, output)) {
+				std::cerr << "Case " << game_index << ": fight engines disagree" << std::endl;
+				consistent = false;
+			}
+		}
+		else {
+			auto& game_output = options.memory_sink ? static_cast<warcraft::output_sink&>(case_output) : output;
+			case_output.clear();
+			if (options.checkpoint >= 0)
+				warcraft::run_game_from_checkpoint(game_index, config, options.engine, game_output, options.checkpoint,
+					phase_pool.get(), recording.get(), cache.get());
+			else
+				warcraft::run_game(game_index, config, options.engine, game_output, phase_pool.get(), recording.get(), cache.get());
+			if (options.memory_sink)
+				output << case_output.str();
+		}
+	}
+	if (options.sweep) {
+		warcraft::run_sweep(games, options, output, cache.get());
+	}
+	else if (options.stress_rounds > 0) {
+		consistent = warcraft::stress_games(games, options, output);
+		if (!consistent)
+			std::cerr << "stress test: outputs are not deterministic" << std::endl;
+	}
+	else if (options.jobs > 1) {
+		consistent = warcraft::run_batch(games, options, output, recording.get(), cache.get());
+	}
+	output.flush();
+	bool write_failed = warcraft::report_write_error(output, "output");
+	if (recording) {
+		recording->flush();
+		write_failed = warcraft::report_write_error(*recording, "replay log") or write_failed;
 	}
-	return 0;
+	if (cache)
+		cache->report(std::cerr);
+#ifdef WARCRAFT_PROFILE
+	// Ƚ̳߳أ̵߳ͳƲŻϲ
+	phase_pool.reset();
+	warcraft::profile_report(std::cerr);
+#endif
+	return consistent and !write_failed ? 0 : 1;
 }